@@ -2,6 +2,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <functional>
+#include <stdexcept>
 
 #include <nanobind/nanobind.h>
 #include <nanobind/operators.h>
@@ -17,6 +18,8 @@
 
 #include "Simulation.hpp"
 #include "Medium.hpp"
+#include "DiagnosticsSample.hpp"
+#include "Sweep.hpp"
 
 namespace nb = nanobind;
 using namespace nb::literals;
@@ -31,6 +34,130 @@ struct Intermediaries_Measure
   nb::object *python_object_ptr;
 };
 
+typedef std::function<void(
+    SimulationState const &sim_state,
+    double time,
+    nb::object &python_object
+  )> PythonMeasurementCallback;
+
+// Forwards a measurement to the Python callback of the intermediaries.
+static void measurement_to_python(
+  SimulationState const &sim_state,
+  double time,
+  void *user_pointer)
+{
+  if (user_pointer == nullptr) return;
+
+  struct Intermediaries_Measure *intermediaries_measure =
+    reinterpret_cast<struct Intermediaries_Measure *>(user_pointer);
+
+  PythonMeasurementCallback outer_callback =
+    intermediaries_measure->python_callback;
+
+  if (outer_callback != nullptr)
+  {
+    outer_callback(
+      sim_state,
+      time,
+      *(intermediaries_measure->python_object_ptr)
+    );
+  } // (outer_callback != nullptr)
+}
+
+static struct Intermediaries_Measure *new_intermediaries_measure(
+  PythonMeasurementCallback const &callback,
+  nb::object &python_object)
+{
+  struct Intermediaries_Measure *intermediaries_measure =
+    new struct Intermediaries_Measure();
+
+  intermediaries_measure->python_callback = callback;
+  intermediaries_measure->python_object_ptr = new nb::object(python_object);
+  return intermediaries_measure;
+}
+
+static void delete_intermediaries_measure(void *user_pointer)
+{
+  if (user_pointer == nullptr) return;
+
+  struct Intermediaries_Measure *intermediaries_measure =
+    reinterpret_cast<struct Intermediaries_Measure *>(user_pointer);
+
+  delete intermediaries_measure->python_object_ptr;
+  delete intermediaries_measure;
+}
+
+// Installs intermediaries for a new Python callback with set_measurement,
+// which refuses while the simulation runs. The previous intermediaries are
+// only released once the new ones are installed.
+template<typename SetMeasurement>
+static void replace_intermediaries_measure(
+  void *previous_user_pointer,
+  PythonMeasurementCallback const &callback,
+  nb::object &python_object,
+  SetMeasurement const &set_measurement)
+{
+  struct Intermediaries_Measure *intermediaries_measure =
+    new_intermediaries_measure(callback, python_object);
+
+  bool installed;
+  {
+    nb::gil_scoped_release release;
+    installed = set_measurement(intermediaries_measure);
+  }
+
+  if (!installed)
+  {
+    delete_intermediaries_measure(intermediaries_measure);
+    throw std::runtime_error(
+      "Cannot change the measurement callback while the simulation is "
+      "running.");
+  }
+
+  delete_intermediaries_measure(previous_user_pointer);
+}
+
+// Simulation instance of Python. Its compute thread may be waiting for the
+// GIL in the measurement callback, so the GIL is released while it is
+// stopped and joined when the instance is released, and its intermediaries
+// are released after.
+struct PythonSimulation : public Simulation
+{
+  ~PythonSimulation()
+  {
+    {
+      nb::gil_scoped_release release;
+      finish();
+    }
+
+    delete_intermediaries_measure(measurement_user_pointer());
+  }
+};
+
+typedef nb::ndarray<nb::numpy, const float, nb::ndim<3>, nb::c_contig>
+  FieldView;
+
+// Read-only view of a field of a snapshot, shaped (z, y, x) over its box,
+// without copying the staging memory it is read back to. The view keeps the
+// Python snapshot alive, but like the snapshot passed to a measurement
+// callback it is only valid during the callback, the staging memory is
+// reused once it returns. None if the field was not read back.
+static nb::object field_view(nb::handle sim_state_handle, int m)
+{
+  SimulationState const &sim_state =
+    nb::cast<SimulationState const &>(sim_state_handle);
+  if (!sim_state.has_field(m)) return nb::none();
+
+  const size_t shape[3] = {
+    static_cast<size_t>(sim_state.region_count(2)),
+    static_cast<size_t>(sim_state.region_count(1)),
+    static_cast<size_t>(sim_state.region_count(0))
+  };
+  return nb::cast(
+    FieldView(sim_state.field_data(m), 3, shape, sim_state_handle),
+    nb::rv_policy::reference);
+}
+
 NB_MODULE(SnowfakePython, m)
 {
   nb::set_leak_warnings(false);
@@ -225,6 +352,194 @@ NB_MODULE(SnowfakePython, m)
       Set the thickness of the seed crystal to generate in mesoscale voxels.
       )");
 
+  nb::class_<MediumSchedule>(m, "MediumSchedule")
+    .def(nb::init<>(),
+      R"(
+      Initialise an empty medium schedule, the medium of the simulation
+      parameters throughout.
+      )")
+    .def("add",
+      &MediumSchedule::add,
+      "step"_a, "medium"_a,
+      R"(
+      Change the medium from the given step on, until the next change. A
+      change at a step already scheduled replaces it. Only kappa, mu and beta
+      of the medium apply, rho and phi only shape the initial fields.
+      )")
+    .def("clear",
+      &MediumSchedule::clear,
+      R"(
+      Remove every change.
+      )")
+    .def("__len__",
+      &MediumSchedule::size)
+    .def_prop_ro("steps",
+      &MediumSchedule::steps,
+      R"(
+      The steps of the changes, in order.
+      )")
+    .def_prop_ro("media",
+      &MediumSchedule::media,
+      R"(
+      The media of the changes, in the order of `steps`.
+      )");
+
+  nb::class_<ReadbackRegion>(m, "ReadbackRegion")
+    .def(nb::init<>(),
+      R"(
+      Initialise a readback region covering all fields over the whole grid.
+      )")
+    .def_prop_rw("occupancy",
+      &ReadbackRegion::occupancy,
+      &ReadbackRegion::set_occupancy,
+      R"(
+      Whether the crystal occupancy field is copied back for measurement.
+      )")
+    .def_prop_rw("diffusive_mass",
+      &ReadbackRegion::diffusive_mass,
+      &ReadbackRegion::set_diffusive_mass,
+      R"(
+      Whether the diffusive mass field is copied back for measurement.
+      )")
+    .def_prop_rw("boundary_mass",
+      &ReadbackRegion::boundary_mass,
+      &ReadbackRegion::set_boundary_mass,
+      R"(
+      Whether the boundary mass field is copied back for measurement.
+      )")
+    .def_prop_rw("x_begin",
+      &ReadbackRegion::x_begin, &ReadbackRegion::set_x_begin,
+      R"(
+      First voxel along x copied back for measurement.
+      )")
+    .def_prop_rw("x_end",
+      &ReadbackRegion::x_end, &ReadbackRegion::set_x_end,
+      R"(
+      One past the last voxel along x copied back, -1 for the end of the grid.
+      )")
+    .def_prop_rw("y_begin",
+      &ReadbackRegion::y_begin, &ReadbackRegion::set_y_begin,
+      R"(
+      First voxel along y copied back for measurement.
+      )")
+    .def_prop_rw("y_end",
+      &ReadbackRegion::y_end, &ReadbackRegion::set_y_end,
+      R"(
+      One past the last voxel along y copied back, -1 for the end of the grid.
+      )")
+    .def_prop_rw("z_begin",
+      &ReadbackRegion::z_begin, &ReadbackRegion::set_z_begin,
+      R"(
+      First voxel along z copied back for measurement.
+      )")
+    .def_prop_rw("z_end",
+      &ReadbackRegion::z_end, &ReadbackRegion::set_z_end,
+      R"(
+      One past the last voxel along z copied back, -1 for the end of the grid.
+      )");
+
+  nb::enum_<SolverKernel>(m, "SolverKernel",
+    R"(
+    Implementation of the solver step. All produce identical results.
+    )")
+    .value("DIRECT", SolverKernel::DIRECT,
+      R"(
+      One invocation per voxel, neighbours loaded from GPU global memory.
+      )")
+    .value("TILED", SolverKernel::TILED,
+      R"(
+      Tiles of voxels with a one voxel halo are staged in workgroup shared
+      memory before the update.
+      )")
+    .value("TEMPORAL_BLOCKED", SolverKernel::TEMPORAL_BLOCKED,
+      R"(
+      Tiles of voxels are advanced `temporal_blocking_steps` steps per
+      dispatch in workgroup shared memory, reducing GPU memory traffic.
+      )")
+    .value("ACTIVE_TILES", SolverKernel::ACTIVE_TILES,
+      R"(
+      Only tiles of voxels that changed, or neighbour a tile that changed, in
+      the previous step are updated, skipping uniform vapour and frozen
+      crystal.
+      )");
+
+  nb::enum_<SymmetryMode>(m, "SymmetryMode",
+    R"(
+    Symmetry of the fields about the centre voxel. With a symmetry only the
+    fundamental wedge of the domain is stored and updated, and full fields
+    are reconstructed for measurement. Results agree with the full domain up
+    to floating point rounding, as neighbour sums are accumulated in a
+    rotated order.
+    )")
+    .value("NONE", SymmetryMode::NONE,
+      R"(
+      The whole domain is stored and updated.
+      )")
+    .value("D6", SymmetryMode::D6,
+      R"(
+      Rotations by sixths of a turn and mirrors in the hexagonal plane, a
+      1/12 wedge is stored.
+      )")
+    .value("D6H", SymmetryMode::D6H,
+      R"(
+      As `D6` plus the mirror in z about the seed plane, a 1/24 wedge is
+      stored. Needs a seed crystal of odd thickness.
+      )");
+
+  nb::enum_<MediumMode>(m, "MediumMode",
+    R"(
+    How the solver receives the medium, and so what a change of the medium
+    by a `MediumSchedule` costs.
+    )")
+    .value("SPECIALISED", MediumMode::SPECIALISED,
+      R"(
+      The solver pipeline is specialised to the medium, which the driver
+      folds into the kernel. A change rebuilds the pipeline and takes effect
+      from the next submission.
+      )")
+    .value("PUSH_CONSTANTS", MediumMode::PUSH_CONSTANTS,
+      R"(
+      The medium is pushed with every solver dispatch. A change takes effect
+      from the next dispatch without rebuilding anything, the kernel reads
+      the medium instead of having it folded in. Uses the direct solver
+      kernel without symmetry.
+      )");
+
+  nb::enum_<MeasurementBackpressure>(m, "MeasurementBackpressure",
+    R"(
+    What the simulation does when a measurement falls due while every
+    snapshot of `SimulationParameters.measurement_depth` is still waiting for
+    or in the measurement callback.
+    )")
+    .value("BLOCK", MeasurementBackpressure::BLOCK,
+      R"(
+      Wait for the callback to finish with the oldest snapshot, every
+      measurement is taken.
+      )")
+    .value("DROP", MeasurementBackpressure::DROP,
+      R"(
+      Skip the measurement, the simulation never waits for the callback.
+      )");
+
+  nb::enum_<FieldLayout>(m, "FieldLayout",
+    R"(
+    How the fields are laid out in GPU memory. Fields are always read back
+    in the planar layout, so measurements and checkpoints do not depend on
+    it.
+    )")
+    .value("PLANAR", FieldLayout::PLANAR,
+      R"(
+      One plane of 32-bit floats per field.
+      )")
+    .value("PACKED", FieldLayout::PACKED,
+      R"(
+      The diffusive and boundary mass of each voxel side by side, and
+      occupancy packed one bit per voxel: about a third less memory per
+      voxel, and less memory traffic per step. Fields are always read back
+      whole and unpacked on the host. Only used by the `DIRECT` solver
+      kernel without symmetry, ensemble, fork or pushed media.
+      )");
+
   nb::class_<SimulationParameters>(m, "SimulationParameters")
     .def(nb::init<>(),
       R"(
@@ -242,6 +557,14 @@ NB_MODULE(SnowfakePython, m)
       R"(
       Set the seed crystal to begin the simulation.
       )")
+    .def_prop_rw("readback",
+      &SimulationParameters::readback,
+      &SimulationParameters::setReadback,
+      R"(
+      The fields and box of voxels copied back from the GPU for each
+      measurement. Samples of fields or voxels not read back are NaN. A run
+      whose region holds no field, or no voxel of the grid, does not start.
+      )")
     .def_prop_rw("voxel_x_count",
       &SimulationParameters::voxelXCount,
       &SimulationParameters::setVoxelXCount,
@@ -260,6 +583,172 @@ NB_MODULE(SnowfakePython, m)
       R"(
       The number of voxels in the simulation extending along the z direction.
       )")
+    .def_prop_rw("steps_per_submit",
+      &SimulationParameters::stepsPerSubmit,
+      &SimulationParameters::setStepsPerSubmit,
+      R"(
+      The number of solver steps recorded into each GPU submission. The host
+      only synchronises with the GPU, and measurements are only taken, once per
+      submission. Larger values reduce submission overhead on small grids.
+      Rounded up to a multiple of the steps per dispatch of the solver kernel.
+      )")
+    .def_prop_rw("measurement_interval",
+      &SimulationParameters::measurementInterval,
+      &SimulationParameters::setMeasurementInterval,
+      R"(
+      The measurement callback is only called, and the fields only copied back
+      from the GPU, on steps that are a multiple of this interval. Steps in
+      between stay resident on the GPU.
+      )")
+    .def_prop_rw("measurement_depth",
+      &SimulationParameters::measurementDepth,
+      &SimulationParameters::setMeasurementDepth,
+      R"(
+      The number of snapshots of the fields downloaded for measurement, at
+      least 2. The measurement callback runs on a thread of its own on the
+      oldest snapshot downloaded while the simulation continues, up to two
+      snapshots are being downloaded at once.
+      )")
+    .def_prop_rw("measurement_backpressure",
+      &SimulationParameters::measurementBackpressure,
+      &SimulationParameters::setMeasurementBackpressure,
+      R"(
+      The `MeasurementBackpressure` when the measurement callback falls
+      behind the simulation.
+      )")
+    .def_prop_rw("diagnostics_interval",
+      &SimulationParameters::diagnosticsInterval,
+      &SimulationParameters::setDiagnosticsInterval,
+      R"(
+      Scalar diagnostics are reduced on the GPU after every step that is a
+      multiple of this interval, and collected in `Simulation.diagnostics`.
+      Zero, the default, disables them.
+      )")
+    .def_prop_rw("solver_kernel",
+      &SimulationParameters::solverKernel,
+      &SimulationParameters::setSolverKernel,
+      R"(
+      The `SolverKernel` implementation of the solver step to use.
+      )")
+    .def_prop_rw("field_layout",
+      &SimulationParameters::fieldLayout,
+      &SimulationParameters::setFieldLayout,
+      R"(
+      The `FieldLayout` of the fields in GPU memory.
+      )")
+    .def_prop_rw("record_every_submission",
+      &SimulationParameters::recordEverySubmission,
+      &SimulationParameters::setRecordEverySubmission,
+      R"(
+      Record the solver command buffers again before every submission
+      instead of resubmitting them unchanged. Only useful to measure the host
+      time recording them once saves, see `Simulation.host_step_seconds`.
+      )")
+    .def_prop_rw("temporal_blocking_steps",
+      &SimulationParameters::temporalBlockingSteps,
+      &SimulationParameters::setTemporalBlockingSteps,
+      R"(
+      The number of solver steps advanced per dispatch by the
+      `TEMPORAL_BLOCKED` solver kernel, from 1 to 3. Measurements and
+      diagnostics can only be taken at the end of a dispatch.
+      )")
+    .def_prop_rw("symmetry",
+      &SimulationParameters::symmetry,
+      &SimulationParameters::setSymmetry,
+      R"(
+      The `SymmetryMode` of the initial fields preserved by the solver. Any
+      symmetry other than `NONE` uses its own solver kernel, ignoring
+      `solver_kernel`.
+      )")
+    .def_prop_rw("adaptive_growth",
+      &SimulationParameters::adaptiveGrowth,
+      &SimulationParameters::setAdaptiveGrowth,
+      R"(
+      Start on a small grid around the seed and grow it towards the voxel
+      counts as the depletion zone spreads. Only without the GUI.
+      Measurements still see the grid of the full voxel counts.
+      )")
+    .def_prop_rw("growth_margin",
+      &SimulationParameters::growthMargin,
+      &SimulationParameters::setGrowthMargin,
+      R"(
+      The number of voxels kept between the depletion zone and the domain
+      radius before the grid grows.
+      )")
+    .def_prop_rw("growth_depletion_tolerance",
+      &SimulationParameters::growthDepletionTolerance,
+      &SimulationParameters::setGrowthDepletionTolerance,
+      R"(
+      The relative deviation of the diffusive mass from the quiescent vapour
+      density above which a voxel counts as depleted.
+      )")
+    .def_prop_rw("pipeline_cache_file",
+      &SimulationParameters::pipelineCacheFile,
+      &SimulationParameters::setPipelineCacheFile,
+      R"(
+      The file the compute pipeline cache is loaded from before the
+      simulation and saved to after it, none if empty. Runs of a parameter
+      sweep sharing the file skip recompiling pipelines they have in common.
+      The file is only used by the same device and driver version.
+      )")
+    .def_prop_rw("checkpoint_file",
+      &SimulationParameters::checkpointFile,
+      &SimulationParameters::setCheckpointFile,
+      R"(
+      The file checkpoints are written to, none if empty. Each checkpoint is
+      written to a temporary file beside it and renamed over the previous
+      one once it is on disk, so the file always holds a whole checkpoint.
+      `Simulation.resume` continues the simulation from it.
+      )")
+    .def_prop_rw("checkpoint_interval",
+      &SimulationParameters::checkpointInterval,
+      &SimulationParameters::setCheckpointInterval,
+      R"(
+      Checkpoints are written after submissions that complete a step which
+      is a multiple of this interval, zero disables them. They are written
+      on a thread of their own while the simulation continues.
+      )")
+    .def_prop_rw("ensemble_media",
+      &SimulationParameters::ensembleMedia,
+      &SimulationParameters::setEnsembleMedia,
+      R"(
+      The list of media of an ensemble of crystals on the same grid, all
+      advanced by each solver dispatch. `medium` is ignored when this is not
+      empty. The measurement callback is called for each member, see
+      `SimulationState.member`. Ensembles use the direct solver kernel
+      without symmetry, adaptive growth or diagnostics.
+      )")
+    .def_prop_rw("fork_step",
+      &SimulationParameters::forkStep,
+      &SimulationParameters::setForkStep,
+      R"(
+      The step at which the simulation forks into one branch per medium of
+      `fork_media`, at the end of the submission reaching it. The fields are
+      copied into the branches on the GPU, which continue independently as
+      an ensemble, see `SimulationState.branch`. Zero never forks. Forked
+      simulations run without symmetry or adaptive growth.
+      )")
+    .def_prop_rw("fork_media",
+      &SimulationParameters::forkMedia,
+      &SimulationParameters::setForkMedia,
+      R"(
+      The list of media of the branches of a fork, see `fork_step`.
+      )")
+    .def_prop_rw("medium_mode",
+      &SimulationParameters::mediumMode,
+      &SimulationParameters::setMediumMode,
+      R"(
+      The `MediumMode` the solver receives the medium in. Ensembles read the
+      media of their members from records either way.
+      )")
+    .def_prop_rw("medium_schedule",
+      &SimulationParameters::mediumSchedule,
+      &SimulationParameters::setMediumSchedule,
+      R"(
+      The `MediumSchedule` of changes of the medium during the simulation,
+      applied as of `medium_mode`. Ensembles, and the branches of a fork,
+      keep the media of their members.
+      )")
     .def_prop_ro("radiusT",
       &SimulationParameters::radiusT,
       R"(
@@ -301,20 +790,236 @@ NB_MODULE(SnowfakePython, m)
       Obtain the boundary mass from the given point in the physical fields
       present in simulation.
       )")
+    .def_prop_ro("occupancy_field",
+      [](nb::handle sim_state) -> nb::object
+      {
+        return field_view(sim_state, FIELD_OCCUPANCY);
+      },
+      R"(
+      A read-only NumPy view of the crystal occupancy over the readback box,
+      indexed [z, y, x] from `region_begin`, None if it was not read back.
+      The view shares the memory the fields are downloaded to without
+      copying it. Like the snapshot passed to the measurement callback, it is
+      only valid during the callback: keep a `.copy()` of it instead. Views
+      of the state of a `SweepResult` are valid while the result is.
+      )")
+    .def_prop_ro("diffusive_mass_field",
+      [](nb::handle sim_state) -> nb::object
+      {
+        return field_view(sim_state, FIELD_DIFFUSIVE_MASS);
+      },
+      R"(
+      A read-only NumPy view of the diffusive mass, as `occupancy_field`.
+      )")
+    .def_prop_ro("boundary_mass_field",
+      [](nb::handle sim_state) -> nb::object
+      {
+        return field_view(sim_state, FIELD_BOUNDARY_MASS);
+      },
+      R"(
+      A read-only NumPy view of the boundary mass, as `occupancy_field`.
+      )")
+    .def_prop_ro("region_begin",
+      [](SimulationState const &sim_state) -> std::tuple<int, int, int>
+      {
+        return std::tuple<int, int, int>(
+          sim_state.region_begin(0),
+          sim_state.region_begin(1),
+          sim_state.region_begin(2));
+      },
+      R"(
+      The (x, y, z) voxel the field views begin at, the first voxel of the
+      readback box.
+      )")
+    .def("sample",
+      [](SimulationState const &sim_state,
+        nb::ndarray<const float, nb::shape<nb::any, 3>, nb::c_contig,
+          nb::device::cpu> points,
+        bool occupancy, bool diffusive_mass, bool boundary_mass)
+      {
+        const unsigned int field_mask =
+          ((occupancy) ? (1 << FIELD_OCCUPANCY) : 0) |
+          ((diffusive_mass) ? (1 << FIELD_DIFFUSIVE_MASS) : 0) |
+          ((boundary_mass) ? (1 << FIELD_BOUNDARY_MASS) : 0);
+        const size_t field_count =
+          size_t(occupancy) + size_t(diffusive_mass) + size_t(boundary_mass);
+        const size_t point_count = points.shape(0);
+
+        float *samples = new float[field_count * point_count];
+        nb::capsule owner(samples, [](void *p) noexcept
+        {
+          delete[] reinterpret_cast<float *>(p);
+        });
+        {
+          nb::gil_scoped_release release;
+          sim_state.sample_points(
+            points.data(), point_count, field_mask, samples);
+        }
+
+        const size_t shape[2] = { field_count, point_count };
+        return nb::ndarray<nb::numpy, float, nb::ndim<2> >(
+          samples, 2, shape, owner);
+      },
+      "points"_a,
+      "occupancy"_a = true,
+      "diffusive_mass"_a = true,
+      "boundary_mass"_a = true,
+      R"(
+      Sample the fields at many points at once, as `occupancy`,
+      `diffusive_mass` and `boundary_mass` do at one. The points are a
+      float32 array of shape (N, 3) of (x, y, z) coordinates. Returns a
+      float32 array of shape (F, N), a row for each selected field in the
+      order of the arguments. Vectorised, with AVX2 where the CPU supports
+      it, and spread over threads for large batches, with the GIL released.
+      )")
     .def("exportSTL",
       &SimulationState::exportSTL,
       "filename"_a,
       R"(
       Export a binary STL file of the current crystal state in the simulation.
+      )")
+    .def_prop_ro("member",
+      &SimulationState::member,
+      R"(
+      The ensemble member, or branch of a forked simulation, this state is
+      of, 0 otherwise.
+      )")
+    .def_prop_ro("branch",
+      &SimulationState::branch,
+      R"(
+      Whether this state is of a branch of a forked simulation, after the
+      fork.
+      )")
+    .def_prop_ro("medium",
+      [](SimulationState const &sim_state) -> Medium
+      {
+        return sim_state.medium();
+      },
+      R"(
+      The medium of the crystal of this state.
       )");
   
-  nb::class_<Simulation>(m, "Simulation")
+  nb::class_<DiagnosticsSample>(m, "DiagnosticsSample")
+    .def_prop_ro("step",
+      &DiagnosticsSample::step,
+      R"(
+      The solver step after which the diagnostics were reduced. With temporal
+      blocking, the last step of the dispatch.
+      )")
+    .def_prop_ro("occupied_voxels",
+      &DiagnosticsSample::occupied_voxels,
+      R"(
+      The number of voxels occupied by the crystal.
+      )")
+    .def_prop_ro("diffusive_mass",
+      &DiagnosticsSample::diffusive_mass,
+      R"(
+      The total diffusive mass over the simulated domain.
+      )")
+    .def_prop_ro("boundary_mass",
+      &DiagnosticsSample::boundary_mass,
+      R"(
+      The total boundary mass over the simulated domain.
+      )")
+    .def_prop_ro("max_radius_t",
+      &DiagnosticsSample::max_radius_t,
+      R"(
+      The largest hexagonal distance from the centre of an occupied voxel in
+      the T-plane.
+      )")
+    .def_prop_ro("max_radius_z",
+      &DiagnosticsSample::max_radius_z,
+      R"(
+      The largest distance from the centre of an occupied voxel in Z.
+      )")
+    .def_prop_ro("attached_voxels",
+      &DiagnosticsSample::attached_voxels,
+      R"(
+      The number of voxels that attached to the crystal during this step, or
+      during the whole dispatch with temporal blocking.
+      )")
+    .def_prop_ro("depleted_radius_t",
+      &DiagnosticsSample::depleted_radius_t,
+      R"(
+      The largest hexagonal distance from the centre of a voxel whose
+      diffusive mass deviates from the vapour density, in the T-plane.
+      )")
+    .def_prop_ro("depleted_radius_z",
+      &DiagnosticsSample::depleted_radius_z,
+      R"(
+      The largest distance from the centre of a voxel whose diffusive mass
+      deviates from the vapour density, in Z.
+      )");
+
+  nb::class_<vkch::PipelineCacheStatistics>(m, "PipelineCacheStatistics")
+    .def_ro("pipelines_created",
+      &vkch::PipelineCacheStatistics::pipelines_created,
+      R"(
+      The number of compute pipelines created.
+      )")
+    .def_ro("programs_reused",
+      &vkch::PipelineCacheStatistics::programs_reused,
+      R"(
+      The number of compute programs reused from an earlier run of the
+      session instead of being created.
+      )")
+    .def_ro("pipelines_with_feedback",
+      &vkch::PipelineCacheStatistics::pipelines_with_feedback,
+      R"(
+      The number of pipelines for which the device reported whether they
+      were found in the cache. None without VK_EXT_pipeline_creation_feedback.
+      )")
+    .def_ro("cache_hits",
+      &vkch::PipelineCacheStatistics::cache_hits,
+      R"(
+      The number of pipelines found in the cache.
+      )")
+    .def_ro("creation_seconds",
+      &vkch::PipelineCacheStatistics::creation_seconds,
+      R"(
+      The total time spent creating pipelines.
+      )")
+    .def_prop_ro("hit_rate",
+      &vkch::PipelineCacheStatistics::hitRate,
+      R"(
+      The fraction of pipelines with feedback found in the cache.
+      )")
+    .def_prop_ro("seconds_saved",
+      &vkch::PipelineCacheStatistics::secondsSaved,
+      R"(
+      The creation time saved by cache hits, estimated from the mean
+      creation time of the misses.
+      )");
+
+  nb::class_<PythonSimulation>(m, "Simulation")
     .def_prop_ro_static("simulation_parameters", [](nb::handle){
         return Simulation::simulation_parameters();
       },
       R"(
       The simulation parameters of the currently running or last run simulation.
       )")
+    .def_prop_ro_static("diagnostics", [](nb::handle){
+        return Simulation::diagnostics();
+      },
+      R"(
+      The list of `DiagnosticsSample` reduced on the GPU so far in the
+      currently running or last run simulation, in step order. Enabled by
+      `SimulationParameters.diagnostics_interval`.
+      )")
+    .def_prop_ro_static("pipeline_cache_statistics", [](nb::handle){
+        return Simulation::pipeline_cache_statistics();
+      },
+      R"(
+      The `PipelineCacheStatistics` of the last run simulation.
+      )")
+    .def_prop_ro_static("host_step_seconds", [](nb::handle){
+        return Simulation::host_step_seconds();
+      },
+      R"(
+      The CPU time the host spent scheduling and submitting each solver step
+      of the currently running or last run simulation, without the time it
+      waited for the GPU.
+      )")
     .def_static("run",
       &Simulation::run,
       nb::call_guard<nb::gil_scoped_release>(),
@@ -322,68 +1027,290 @@ NB_MODULE(SnowfakePython, m)
       R"(
       Start a new simulation with the simulation parameters in the given medium.
       )")
+    .def_static("resume",
+      &Simulation::resume,
+      nb::call_guard<nb::gil_scoped_release>(),
+      "checkpoint_file"_a,
+      R"(
+      Continue the simulation saved in the checkpoint file with the
+      parameters it was started with, from the step after the checkpoint,
+      without initialising the fields. Returns False if the file holds no
+      whole checkpoint.
+      )")
+    .def_static("begin_session",
+      &Simulation::begin_session,
+      R"(
+      Keep the Vulkan context, its memory allocations and its compiled
+      programs between runs until `end_session`. Back-to-back runs then only
+      reinitialise the fields, reusing allocations that fit and programs
+      whose parameters are unchanged.
+      )")
+    .def_static("end_session",
+      &Simulation::end_session,
+      R"(
+      Release the Vulkan context kept since `begin_session`.
+      )")
     .def_static("stop",
       &Simulation::stop,
       R"(
       Stop a currently running simulation, usually used from within a callback.
       )")
+    .def_static("stop_member",
+      &Simulation::stop_member,
+      "member"_a,
+      R"(
+      Stop one member of a currently running ensemble, the others carry on.
+      The simulation stops with its last member.
+      )")
     .def_static("measurement",
       [](
-        std::function<void(
-          SimulationState const &sim_state,
-          double time,
-          nb::object &python_object)> callback,
+        PythonMeasurementCallback callback,
         nb::object &python_object
       ) -> void
       {
-        auto cpp_callback = [](
-          SimulationState const &sim_state,
-          double time,
-          void *user_pointer) -> void
-        {
-          if (user_pointer == nullptr) return;
-
-          struct Intermediaries_Measure *intermediaries_measure =
-            reinterpret_cast<struct Intermediaries_Measure *>(user_pointer);
+        replace_intermediaries_measure(
+          Simulation::get_measurement_user_pointer(),
+          callback, python_object,
+          [](struct Intermediaries_Measure *intermediaries_measure)
+          {
+            return Simulation::measurement(
+              &measurement_to_python, intermediaries_measure);
+          });
+      },
+      R"(
+      Set the measurement callback of the simulation, called with the
+      simulation state, the step and the data object. Raises RuntimeError
+      while the simulation is running.
+      )")
+    .def(nb::init<>(),
+      R"(
+      An independent simulation, started with `start`. Instances run without
+      the GUI, each on its own tensors and schemas on a Vulkan device shared
+      by all instances, so several small simulations can run concurrently.
+      )")
+    .def("start",
+      [](
+        PythonSimulation &simulation,
+        SimulationParameters const &simulation_parameters
+      ) -> bool
+      {
+        return simulation.start(simulation_parameters);
+      },
+      nb::call_guard<nb::gil_scoped_release>(),
+      "simulation_parameters"_a,
+      R"(
+      Start this simulation with the simulation parameters and return at
+      once. Returns False if it is already running.
+      )")
+    .def("wait",
+      [](PythonSimulation &simulation) { simulation.wait(); },
+      nb::call_guard<nb::gil_scoped_release>(),
+      R"(
+      Wait for this simulation to finish. A simulation still running when it
+      is released is stopped and waited for.
+      )")
+    .def("request_stop",
+      [](PythonSimulation &simulation) { simulation.request_stop(); },
+      R"(
+      Ask this simulation to finish, usually from within its measurement
+      callback.
+      )")
+    .def("request_member_stop",
+      [](PythonSimulation &simulation, int member)
+      {
+        simulation.request_member_stop(member);
+      },
+      "member"_a,
+      R"(
+      Ask one member of this simulation's ensemble to finish.
+      )")
+    .def_prop_ro("running",
+      [](PythonSimulation const &simulation)
+      {
+        return simulation.is_running();
+      },
+      R"(
+      Whether this simulation is running.
+      )")
+    .def_prop_ro("parameters",
+      [](PythonSimulation const &simulation)
+      {
+        return simulation.parameters();
+      },
+      R"(
+      The simulation parameters of this simulation's current or last run.
+      )")
+    .def_prop_ro("collected_diagnostics",
+      [](PythonSimulation const &simulation)
+      {
+        return simulation.collected_diagnostics();
+      },
+      R"(
+      The list of `DiagnosticsSample` of this simulation's current or last
+      run, in step order.
+      )")
+    .def_prop_ro("host_seconds_per_step",
+      [](PythonSimulation const &simulation)
+      {
+        return simulation.host_seconds_per_step();
+      },
+      R"(
+      The host CPU time per solver step of this simulation's current or last
+      run, as `Simulation.host_step_seconds`.
+      )")
+    .def("set_measurement",
+      [](
+        PythonSimulation &simulation,
+        PythonMeasurementCallback callback,
+        nb::object &python_object
+      ) -> void
+      {
+        replace_intermediaries_measure(
+          simulation.measurement_user_pointer(),
+          callback, python_object,
+          [&simulation](struct Intermediaries_Measure *intermediaries_measure)
+          {
+            return simulation.set_measurement(
+              &measurement_to_python, intermediaries_measure);
+          });
+      },
+      "callback"_a,
+      "data"_a,
+      R"(
+      Set the measurement callback of this simulation, called with the
+      simulation state, the step and the data object. It runs on a thread of
+      its own while the simulation continues, see
+      `SimulationParameters.measurement_depth`. Snapshots still waiting when
+      the simulation is asked to stop are not measured. Raises RuntimeError
+      while the simulation is running.
+      )");
 
-          std::function<void(
-            SimulationState const &sim_state,
-            double time,
-            nb::object &python_object
-          )> outer_callback =
-            intermediaries_measure->python_callback;
+  nb::class_<SweepStopCondition>(m, "SweepStopCondition")
+    .def(nb::init<>())
+    .def_prop_rw("max_steps",
+      &SweepStopCondition::maxSteps,
+      &SweepStopCondition::setMaxSteps,
+      R"(
+      The number of steps after which a run finishes, checked at its
+      measurements.
+      )")
+    .def_prop_rw("max_radius_t",
+      &SweepStopCondition::maxRadiusT,
+      &SweepStopCondition::setMaxRadiusT,
+      R"(
+      The crystal radius in the T-plane at which a run finishes, zero for
+      none. Taken from the diagnostics, so runs need a diagnostics interval.
+      )")
+    .def_prop_rw("max_radius_z",
+      &SweepStopCondition::maxRadiusZ,
+      &SweepStopCondition::setMaxRadiusZ,
+      R"(
+      The crystal radius in Z at which a run finishes, zero for none.
+      )");
 
-          if (outer_callback != nullptr)
-          {
-            outer_callback(
-              sim_state,
-              time,
-              *(intermediaries_measure->python_object_ptr)
-            );
-          } // (outer_callback != nullptr)
-        };
-
-        if (Simulation::get_measurement_user_pointer())
+  nb::class_<SweepResult>(m, "SweepResult")
+    .def_ro("index",
+      &SweepResult::index,
+      R"(
+      The position of the run in the list given to the sweep.
+      )")
+    .def_ro("parameters",
+      &SweepResult::parameters,
+      R"(
+      The simulation parameters of the run.
+      )")
+    .def_ro("completed",
+      &SweepResult::completed,
+      R"(
+      Whether the run reached the stop condition, otherwise it failed or the
+      sweep was stopped.
+      )")
+    .def_ro("steps",
+      &SweepResult::steps,
+      R"(
+      The step of the last measurement of the run.
+      )")
+    .def_ro("diagnostics",
+      &SweepResult::diagnostics,
+      R"(
+      The list of `DiagnosticsSample` of the run.
+      )")
+    .def_ro("device",
+      &SweepResult::device,
+      R"(
+      The index of the physical device the run was scheduled on.
+      )")
+    .def_ro("queue",
+      &SweepResult::queue,
+      R"(
+      The compute queue of the device the run was scheduled on.
+      )")
+    .def("state",
+      [](SweepResult const &result) -> SimulationState
+      {
+        if (!result.has_state())
         {
-          struct Intermediaries_Measure *intermediaries_measure =
-              reinterpret_cast<struct Intermediaries_Measure *>(
-                  Simulation::get_measurement_user_pointer());
-
-          delete intermediaries_measure->python_object_ptr;
-          delete intermediaries_measure;
+          throw std::runtime_error(
+            "The run did not complete, it has no final state.");
         }
+        return result.state();
+      },
+      nb::keep_alive<0, 1>(),
+      R"(
+      The `SimulationState` of the measurement that reached the stop
+      condition, for example to export an STL file. Raises RuntimeError if
+      the run did not complete.
+      )");
 
-        struct Intermediaries_Measure *intermediaries_measure =
-          new struct Intermediaries_Measure();
-        
-        intermediaries_measure->python_callback = callback;
-        intermediaries_measure->python_object_ptr = new nb::object(python_object);
+  nb::class_<Sweep>(m, "Sweep")
+    .def(nb::init<uint32_t, uintmax_t>(),
+      "queues_per_device"_a = 0,
+      "memory_budget"_a = 0,
+      R"(
+      A scheduler of runs over every compute queue of every physical device,
+      at most queues_per_device queues each (zero for all). The runs on a
+      device share a memory budget in bytes, by default half of its largest
+      device local heap.
+      )")
+    .def("run",
+      [](
+        Sweep &sweep,
+        std::vector<SimulationParameters> const &runs,
+        SweepStopCondition const &stop_condition,
+        std::function<void(SweepResult result)> callback
+      ) -> void
+      {
+        nb::gil_scoped_release release;
+        sweep.run(runs, stop_condition,
+          [](SweepResult const &result, void *user_pointer) -> void
+          {
+            std::function<void(SweepResult result)> &outer_callback =
+              *reinterpret_cast<std::function<void(SweepResult result)> *>(
+                user_pointer);
 
-        {
-          nb::gil_scoped_release release;
-          Simulation::measurement(
-            cpp_callback, intermediaries_measure);
-        }
-      });
+            outer_callback(result);
+          },
+          &callback);
+      },
+      "runs"_a,
+      "stop_condition"_a,
+      "callback"_a,
+      R"(
+      Run all of the simulation parameters until the stop condition and
+      return once the last has finished. The callback is called with each
+      `SweepResult` as soon as its run finishes.
+      )")
+    .def("request_stop",
+      &Sweep::request_stop,
+      R"(
+      Stop the runs in progress and skip those not yet started, e.g. from
+      the callback.
+      )")
+    .def_prop_ro("worker_count",
+      &Sweep::worker_count,
+      R"(
+      The number of compute queues runs are scheduled on, over all devices.
+      Devices are opened by the first run.
+      )");
     
   }
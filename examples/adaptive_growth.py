@@ -0,0 +1,62 @@
+from SnowfakePython import *
+from math import *
+import sys
+import time
+
+# Compares the full grid against adaptive growth, which starts on a small grid
+# around the seed and grows it as the depletion zone spreads. Measurements see
+# the full grid either way; masses differ slightly where the periodic wrap of
+# a small grid reached the depletion zone.
+
+medium = Medium()
+medium.rho = 0.1
+medium.kappa = 0.1
+medium.mu = 0.001
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+stop_step = 4000
+
+class MeasurementData:
+  def __init__(self, stoptime : int):
+    self.stop_time = stoptime
+    self.profile = []
+    pass
+
+def measure_callback(sim_state: SimulationState,
+  time: float,
+  data: MeasurementData):
+    if (time >= data.stop_time):
+      data.profile = [sim_state.occupancy(i, 0, 0) for i in range(-60, 61)]
+      Simulation.stop()
+
+for adaptive_growth in [False, True]:
+  sim_params = SimulationParameters()
+  sim_params.medium = medium
+  sim_params.seed = seed_crystal
+  sim_params.voxel_x_count = 512
+  sim_params.voxel_y_count = 512
+  sim_params.voxel_z_count = 256
+  sim_params.steps_per_submit = 16
+  sim_params.measurement_interval = stop_step
+  sim_params.diagnostics_interval = 64
+  sim_params.adaptive_growth = adaptive_growth
+  sim_params.growth_margin = 8
+
+  measurement_data = MeasurementData(stop_step)
+  Simulation.measurement(measure_callback, measurement_data)
+
+  start = time.perf_counter()
+  Simulation.run(sim_params)
+  elapsed = time.perf_counter() - start
+
+  diagnostics = Simulation.diagnostics
+  print("adaptive growth {}: {:.2f}s, {:d} occupied voxels, "
+    "depleted radius {:d}/{:d}".format(
+    adaptive_growth, elapsed,
+    diagnostics[-1].occupied_voxels,
+    diagnostics[-1].depleted_radius_t,
+    diagnostics[-1].depleted_radius_z))
+  print("".join("#" if v > 0.0 else "." for v in measurement_data.profile))
@@ -0,0 +1,59 @@
+from SnowfakePython import *
+import time
+
+# Time per solver step with the fields in each layout on the GPU. The packed
+# layout moves less memory per voxel update, which bounds the direct solver
+# kernel on large grids. Measurements see the same fields either way.
+steps = 2000
+size = (256, 256, 256)
+layouts = [FieldLayout.PLANAR, FieldLayout.PACKED]
+
+medium = Medium()
+medium.rho = 0.1
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+class MeasurementData:
+  def __init__(self, stoptime : int):
+    self.stop_time = stoptime
+    self.start = None
+    self.start_step = 0
+    self.occupied = 0
+    pass
+
+# Measurement callback
+def measure_callback(sim_state: SimulationState,
+  time_step: float,
+  data: MeasurementData):
+    if (data.start is None):
+      data.start = time.perf_counter()
+      data.start_step = time_step
+    if (time_step >= data.stop_time):
+      data.end = time.perf_counter()
+      data.end_step = time_step
+      data.occupied = int((sim_state.occupancy_field > 0.0).sum())
+      Simulation.stop()
+
+for layout in layouts:
+  sim_params = SimulationParameters()
+  sim_params.medium = medium
+  sim_params.seed = seed_crystal
+  sim_params.voxel_x_count = size[0]
+  sim_params.voxel_y_count = size[1]
+  sim_params.voxel_z_count = size[2]
+  sim_params.steps_per_submit = 16
+  sim_params.measurement_interval = steps // 2
+  sim_params.field_layout = layout
+
+  # The clock starts at the first measurement, after the first submission.
+  measurement_data = MeasurementData(steps)
+  Simulation.measurement(measure_callback, measurement_data)
+  Simulation.run(sim_params)
+
+  elapsed = measurement_data.end - measurement_data.start
+  timed_steps = measurement_data.end_step - measurement_data.start_step
+  print("{:s}: {:.2f} us per step, {:d} voxels occupied".format(
+    str(layout), 1e6 * elapsed / timed_steps, measurement_data.occupied),
+    flush=True)
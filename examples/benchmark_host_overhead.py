@@ -0,0 +1,49 @@
+from SnowfakePython import *
+
+# Host CPU time per solver step, spent scheduling and submitting the steps,
+# without the time the host waits for the GPU. Each configuration runs twice:
+# recording the step command buffers again before every submission, as they
+# used to be, and recording them once and resubmitting them.
+steps = 20000
+sizes = [(16, 16, 16), (32, 32, 32)]
+steps_per_submits = [1, 4, 16]
+
+medium = Medium()
+medium.rho = 0.1
+medium.kappa = 0.1
+medium.mu = 0.001
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+# Measurement callback
+def measure_callback(sim_state: SimulationState,
+  time_step: float,
+  stop_time: int):
+    if (time_step >= stop_time):
+      Simulation.stop()
+
+for size in sizes:
+  for steps_per_submit in steps_per_submits:
+    host_step_seconds = []
+    for record_every_submission in [True, False]:
+      sim_params = SimulationParameters()
+      sim_params.medium = medium
+      sim_params.seed = seed_crystal
+      sim_params.voxel_x_count = size[0]
+      sim_params.voxel_y_count = size[1]
+      sim_params.voxel_z_count = size[2]
+      sim_params.steps_per_submit = steps_per_submit
+      sim_params.measurement_interval = steps
+      sim_params.record_every_submission = record_every_submission
+
+      Simulation.measurement(measure_callback, steps)
+      Simulation.run(sim_params)
+      host_step_seconds.append(Simulation.host_step_seconds)
+
+    print("{:d}x{:d}x{:d}, {:d} steps per submit: {:.2f} us per step "
+      "recorded every submission, {:.2f} us recorded once ({:.1f}x)".format(
+      size[0], size[1], size[2], steps_per_submit,
+      1e6 * host_step_seconds[0], 1e6 * host_step_seconds[1],
+      host_step_seconds[0] / host_step_seconds[1]), flush=True)
@@ -0,0 +1,59 @@
+from SnowfakePython import *
+import time
+
+# A measurement callback that takes a while, standing in for analysis in
+# Python. The callback runs on a thread of its own, so the solver carries on
+# while it runs: with enough snapshots the run takes about as long as the
+# longer of the solver and the callbacks, rather than their sum. Dropping
+# measurements never waits for the callback at all.
+steps = 4000
+callback_seconds = 0.05
+configurations = [
+  (2, MeasurementBackpressure.BLOCK),
+  (4, MeasurementBackpressure.BLOCK),
+  (4, MeasurementBackpressure.DROP)
+]
+
+medium = Medium()
+medium.rho = 0.1
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+class MeasurementData:
+  def __init__(self, stoptime : int):
+    self.stop_time = stoptime
+    self.measurements = 0
+    pass
+
+# Measurement callback
+def measure_callback(sim_state: SimulationState,
+  time_step: float,
+  data: MeasurementData):
+    data.measurements += 1
+    time.sleep(callback_seconds)
+    if (time_step >= data.stop_time):
+      Simulation.stop()
+
+for depth, backpressure in configurations:
+  sim_params = SimulationParameters()
+  sim_params.medium = medium
+  sim_params.seed = seed_crystal
+  sim_params.voxel_x_count = 128
+  sim_params.voxel_y_count = 128
+  sim_params.voxel_z_count = 128
+  sim_params.steps_per_submit = 16
+  sim_params.measurement_interval = 64
+  sim_params.measurement_depth = depth
+  sim_params.measurement_backpressure = backpressure
+
+  measurement_data = MeasurementData(steps)
+  Simulation.measurement(measure_callback, measurement_data)
+  start = time.perf_counter()
+  Simulation.run(sim_params)
+  elapsed = time.perf_counter() - start
+
+  print("depth {:d} {:s}: {:.3f} s, {:d} measurements".format(
+    depth, str(backpressure), elapsed, measurement_data.measurements),
+    flush=True)
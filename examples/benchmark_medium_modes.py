@@ -0,0 +1,79 @@
+from SnowfakePython import *
+from math import *
+import sys
+import time
+
+# Compares specialised and pushed media in voxel updates per second, with a
+# constant medium and with one that changes every few submissions. The
+# specialised solver folds the medium into the kernel but rebuilds its
+# pipeline for each change, the pushed solver reads the medium with every
+# dispatch instead.
+steps = 2000
+change_interval = 64
+sizes = [(64, 64, 64), (128, 128, 128), (320, 320, 256)]
+modes = [MediumMode.SPECIALISED, MediumMode.PUSH_CONSTANTS]
+
+medium = Medium()
+medium.rho = 0.1
+medium.kappa = 0.1
+medium.mu = 0.001
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+# Lower kappa a little with every change, so every change needs a pipeline
+# of its own when specialised.
+schedule = MediumSchedule()
+for change in range(1, steps // change_interval):
+  changed_medium = Medium()
+  changed_medium.rho = 0.1
+  changed_medium.kappa = 0.1 - 0.001 * change
+  changed_medium.mu = 0.001
+  schedule.add(change * change_interval, changed_medium)
+
+class MeasurementData:
+  def __init__(self, stoptime : int):
+    self.stop_time = stoptime
+    self.start = None
+    pass
+
+# Measurement callback
+def measure_callback(sim_state: SimulationState,
+  time_step: float,
+  data: MeasurementData):
+    if (data.start is None):
+      data.start = time.perf_counter()
+    if (time_step >= data.stop_time):
+      data.end = time.perf_counter()
+      Simulation.stop()
+
+for size in sizes:
+  for mode in modes:
+    for scheduled in [False, True]:
+      sim_params = SimulationParameters()
+      sim_params.medium = medium
+      sim_params.seed = seed_crystal
+      sim_params.voxel_x_count = size[0]
+      sim_params.voxel_y_count = size[1]
+      sim_params.voxel_z_count = size[2]
+      sim_params.steps_per_submit = 16
+      sim_params.measurement_interval = steps
+      sim_params.medium_mode = mode
+      if scheduled:
+        sim_params.medium_schedule = schedule
+
+      # The clock starts at the first measurement, after the first submission.
+      measurement_data = MeasurementData(steps)
+      Simulation.measurement(measure_callback, measurement_data)
+      Simulation.run(sim_params)
+
+      elapsed = measurement_data.end - measurement_data.start
+      voxel_updates = float(size[0] * size[1] * size[2]) * steps
+      stats = Simulation.pipeline_cache_statistics
+      print("{:d}x{:d}x{:d} {:s}{:s}: {:.3f} s, {:.3e} voxel updates/s, "
+        "{:d} pipelines created in {:.3f} s".format(
+        size[0], size[1], size[2], str(mode),
+        " scheduled" if scheduled else "", elapsed,
+        voxel_updates / elapsed, stats.pipelines_created,
+        stats.creation_seconds), flush=True)
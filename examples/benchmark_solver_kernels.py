@@ -0,0 +1,59 @@
+from SnowfakePython import *
+from math import *
+import sys
+import time
+
+# Compares the solver kernels in voxel updates per second. The fields are only
+# copied back at the end of each run, so the time is dominated by the solver.
+steps = 2000
+sizes = [(64, 64, 64), (128, 128, 128), (320, 320, 256)]
+kernels = [SolverKernel.DIRECT, SolverKernel.TILED, SolverKernel.ACTIVE_TILES,
+  SolverKernel.TEMPORAL_BLOCKED]
+
+medium = Medium()
+medium.rho = 0.1
+medium.kappa = 0.1
+medium.mu = 0.001
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+class MeasurementData:
+  def __init__(self, stoptime : int):
+    self.stop_time = stoptime
+    self.start = None
+    pass
+
+# Measurement callback
+def measure_callback(sim_state: SimulationState,
+  time_step: float,
+  data: MeasurementData):
+    if (data.start is None):
+      data.start = time.perf_counter()
+    if (time_step >= data.stop_time):
+      data.end = time.perf_counter()
+      Simulation.stop()
+
+for size in sizes:
+  for kernel in kernels:
+    sim_params = SimulationParameters()
+    sim_params.medium = medium
+    sim_params.seed = seed_crystal
+    sim_params.voxel_x_count = size[0]
+    sim_params.voxel_y_count = size[1]
+    sim_params.voxel_z_count = size[2]
+    sim_params.steps_per_submit = 16
+    sim_params.measurement_interval = steps
+    sim_params.solver_kernel = kernel
+
+    # The clock starts at the first measurement, after the first submission.
+    measurement_data = MeasurementData(steps)
+    Simulation.measurement(measure_callback, measurement_data)
+    Simulation.run(sim_params)
+
+    elapsed = measurement_data.end - measurement_data.start
+    voxel_updates = float(size[0] * size[1] * size[2]) * steps
+    print("{:d}x{:d}x{:d} {:s}: {:.3f} s, {:.3e} voxel updates/s".format(
+      size[0], size[1], size[2], str(kernel), elapsed,
+      voxel_updates / elapsed), flush=True)
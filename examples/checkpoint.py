@@ -0,0 +1,53 @@
+from SnowfakePython import *
+import os
+
+# A long run writes a checkpoint every few hundred steps while it carries on.
+# Stopping it part way stands in for a crash or pre-emption, the resumed run
+# continues from the last checkpoint instead of starting over.
+
+checkpoint_file = "snowflake.checkpoint"
+
+medium = Medium()
+medium.rho = 0.1
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+sim_params = SimulationParameters()
+sim_params.medium = medium
+sim_params.seed = seed_crystal
+sim_params.voxel_x_count = 256
+sim_params.voxel_y_count = 256
+sim_params.voxel_z_count = 128
+sim_params.steps_per_submit = 16
+sim_params.measurement_interval = 256
+sim_params.checkpoint_file = checkpoint_file
+sim_params.checkpoint_interval = 512
+
+interrupt_step = 2000
+stop_step = 4000
+
+def interrupted_callback(sim_state: SimulationState,
+  time: float,
+  data):
+    print("step {:.0f}".format(time))
+    if (time >= interrupt_step):
+      Simulation.stop()
+
+def resumed_callback(sim_state: SimulationState,
+  time: float,
+  data):
+    print("resumed, step {:.0f}".format(time))
+    if (time >= stop_step):
+      Simulation.stop()
+
+Simulation.measurement(interrupted_callback, None)
+Simulation.run(sim_params)
+
+Simulation.measurement(resumed_callback, None)
+if not Simulation.resume(checkpoint_file):
+  print("no checkpoint written")
+
+if os.path.exists(checkpoint_file):
+  os.remove(checkpoint_file)
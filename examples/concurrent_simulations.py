@@ -0,0 +1,53 @@
+from SnowfakePython import *
+
+# Several small simulations, one per rho, run concurrently on the same GPU.
+# Each Simulation instance runs without the GUI on tensors of its own.
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+stop_step = 2000
+
+# Measurement callback, data is the simulation to stop
+def measure_callback(sim_state: SimulationState,
+  time: float,
+  simulation: Simulation):
+    if (time >= stop_step):
+      simulation.request_stop()
+
+simulations = []
+for rho in [0.08, 0.1, 0.12, 0.14]:
+  medium = Medium()
+  medium.rho = rho
+
+  sim_params = SimulationParameters()
+  sim_params.medium = medium
+  sim_params.seed = seed_crystal
+  sim_params.voxel_x_count = 64
+  sim_params.voxel_y_count = 64
+  sim_params.voxel_z_count = 32
+  sim_params.measurement_interval = 100
+  sim_params.diagnostics_interval = 100
+
+  simulation = Simulation()
+  simulation.set_measurement(measure_callback, simulation)
+  simulations.append((rho, simulation, sim_params))
+
+for rho, simulation, sim_params in simulations:
+  simulation.start(sim_params)
+
+# Instances must have finished before they are released.
+for rho, simulation, sim_params in simulations:
+  simulation.wait()
+
+print("rho step occupied total_mass radius_t radius_z")
+for rho, simulation, sim_params in simulations:
+  sample = simulation.collected_diagnostics[-1]
+  print("{:f} {:d} {:d} {:f} {:d} {:d}".format(
+    rho,
+    sample.step,
+    sample.occupied_voxels,
+    sample.diffusive_mass + sample.boundary_mass,
+    sample.max_radius_t,
+    sample.max_radius_z))
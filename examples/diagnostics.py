@@ -0,0 +1,58 @@
+from SnowfakePython import *
+from math import *
+import sys
+
+# Default medium is 'canonical' air
+medium = Medium()
+medium.rho = 0.1
+medium.kappa = 0.1
+medium.mu = 0.001
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+sim_params = SimulationParameters()
+sim_params.medium = medium
+sim_params.seed = seed_crystal
+sim_params.voxel_x_count = 128
+sim_params.voxel_y_count = 128
+sim_params.voxel_z_count = 64
+sim_params.steps_per_submit = 8
+# Fields are only copied back for the callback every 1000 steps, the scalar
+# diagnostics are reduced on the GPU every step.
+sim_params.measurement_interval = 1000
+sim_params.diagnostics_interval = 1
+
+class MeasurementData:
+  def __init__(self, stoptime : int):
+    self.stop_time = stoptime
+    pass
+
+# Measurement callback
+def measure_callback(sim_state: SimulationState,
+  time: float,
+  data: MeasurementData):
+    print("{:d}... ".format(int(time)), end='', flush=True)
+    if (time >= data.stop_time):
+      Simulation.stop()
+
+measurement_data = MeasurementData(10000)
+
+Simulation.measurement(measure_callback, measurement_data)
+
+Simulation.run(sim_params)
+
+print()
+print("step occupied diffusive_mass boundary_mass total_mass "
+  "radius_t radius_z attached")
+for sample in Simulation.diagnostics[::100]:
+  print("{:d} {:d} {:f} {:f} {:f} {:d} {:d} {:d}".format(
+    sample.step,
+    sample.occupied_voxels,
+    sample.diffusive_mass,
+    sample.boundary_mass,
+    sample.diffusive_mass + sample.boundary_mass,
+    sample.max_radius_t,
+    sample.max_radius_z,
+    sample.attached_voxels))
@@ -0,0 +1,53 @@
+from SnowfakePython import *
+from math import *
+
+# A parameter study of many small crystals differing only in their medium,
+# all advanced together by each dispatch of the ensemble solver. Each member
+# stops on its own once its crystal reaches the edge of the domain.
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+media = []
+for rho in [0.08, 0.1, 0.12, 0.14]:
+  for beta in [1.3, 1.6, 2.0, 2.5]:
+    medium = Medium()
+    medium.rho = rho
+    medium.beta = beta
+    media.append(medium)
+
+sim_params = SimulationParameters()
+sim_params.seed = seed_crystal
+sim_params.voxel_x_count = 64
+sim_params.voxel_y_count = 64
+sim_params.voxel_z_count = 32
+sim_params.ensemble_media = media
+sim_params.steps_per_submit = 8
+sim_params.measurement_interval = 200
+sim_params.diagnostics_interval = 0
+
+class MeasurementData:
+  def __init__(self, member_count : int, stoptime : int):
+    self.stop_time = stoptime
+    self.stopped_at = [None] * member_count
+
+# Measurement callback, called for each member still running
+def measure_callback(sim_state: SimulationState,
+  time: float,
+  data: MeasurementData):
+    edge_x = (sim_params.radiusT - 2) * sqrt(3.0) / 2.0
+    reached_edge = (sim_state.occupancy(edge_x, 0, 0) > 0.5)
+    if (reached_edge or (time >= data.stop_time)):
+      data.stopped_at[sim_state.member] = int(time)
+      Simulation.stop_member(sim_state.member)
+
+measurement_data = MeasurementData(len(media), 20000)
+
+Simulation.measurement(measure_callback, measurement_data)
+
+Simulation.run(sim_params)
+
+print("rho beta stopped_at")
+for medium, stopped_at in zip(media, measurement_data.stopped_at):
+  print("{:f} {:f} {}".format(medium.rho, medium.beta, stopped_at))
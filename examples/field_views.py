@@ -0,0 +1,47 @@
+from SnowfakePython import *
+import numpy as np
+
+# Analyse the fields in NumPy through views of the memory they are read back
+# to, instead of sampling them voxel by voxel.
+
+medium = Medium()
+medium.rho = 0.1
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+sim_params = SimulationParameters()
+sim_params.medium = medium
+sim_params.seed = seed_crystal
+sim_params.voxel_x_count = 128
+sim_params.voxel_y_count = 128
+sim_params.voxel_z_count = 64
+sim_params.steps_per_submit = 16
+sim_params.measurement_interval = 1000
+
+stop_step = 5000
+snapshots = []
+
+def measure_callback(sim_state: SimulationState,
+  time: float,
+  data):
+    occupancy = sim_state.occupancy_field
+    diffusive_mass = sim_state.diffusive_mass_field
+    occupied = occupancy > 0.0
+    layers = np.nonzero(occupied.any(axis=(1, 2)))[0]
+    print("step {:.0f}: {:d} voxels occupied in {:d} layers, "
+      "{:.1f} diffusive mass".format(time, int(np.count_nonzero(occupied)),
+      len(layers), float(diffusive_mass.sum())))
+
+    # The views are only valid during the callback, copies are kept.
+    snapshots.append(occupancy.copy())
+    if (time >= stop_step):
+      Simulation.stop()
+
+Simulation.measurement(measure_callback, None)
+Simulation.run(sim_params)
+
+growth = np.count_nonzero(snapshots[-1]) - np.count_nonzero(snapshots[0])
+print("{:d} voxels crystallised between the first and last snapshot".format(
+  growth))
@@ -0,0 +1,46 @@
+from SnowfakePython import *
+
+# Grow a crystal through a shared prefix once, then fork it on the GPU into
+# branches that vary the vapour density for the rest of the run, instead of
+# recomputing the prefix for every variation.
+
+medium = Medium()
+medium.rho = 0.1
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+branch_media = []
+for rho in [0.08, 0.1, 0.12, 0.14]:
+  branch_medium = Medium()
+  branch_medium.rho = rho
+  branch_media.append(branch_medium)
+
+fork_step = 2000
+stop_step = 6000
+
+sim_params = SimulationParameters()
+sim_params.medium = medium
+sim_params.seed = seed_crystal
+sim_params.voxel_x_count = 128
+sim_params.voxel_y_count = 128
+sim_params.voxel_z_count = 64
+sim_params.steps_per_submit = 16
+sim_params.measurement_interval = 1000
+sim_params.fork_step = fork_step
+sim_params.fork_media = branch_media
+
+def measure_callback(sim_state: SimulationState,
+  time: float,
+  data):
+    if sim_state.branch:
+      print("step {:.0f}, branch {:d}, rho {:f}".format(
+        time, sim_state.member, sim_state.medium.rho))
+      if (time >= stop_step):
+        Simulation.stop_member(sim_state.member)
+    else:
+      print("step {:.0f}, before the fork".format(time))
+
+Simulation.measurement(measure_callback, None)
+Simulation.run(sim_params)
@@ -0,0 +1,45 @@
+from SnowfakePython import *
+import sys
+import time
+
+# Runs the same short simulation twice with a pipeline cache file. The second
+# run, like a second process, finds its pipelines in the cache.
+
+cache_file = sys.argv[1] if len(sys.argv) > 1 else "snowfake_pipelines.bin"
+
+medium = Medium()
+medium.rho = 0.1
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+stop_step = 64
+
+def measure_callback(sim_state: SimulationState,
+  time: float,
+  data):
+    if (time >= stop_step):
+      Simulation.stop()
+
+for run in range(2):
+  sim_params = SimulationParameters()
+  sim_params.medium = medium
+  sim_params.seed = seed_crystal
+  sim_params.voxel_x_count = 128
+  sim_params.voxel_y_count = 128
+  sim_params.voxel_z_count = 64
+  sim_params.measurement_interval = stop_step
+  sim_params.pipeline_cache_file = cache_file
+
+  Simulation.measurement(measure_callback, None)
+
+  start = time.perf_counter()
+  Simulation.run(sim_params)
+  elapsed = time.perf_counter() - start
+
+  stats = Simulation.pipeline_cache_statistics
+  print("run {:d}: {:.2f}s, {:d} pipelines in {:.3f}s, "
+    "{:.0f}% cache hits, {:.3f}s saved".format(
+    run, elapsed, stats.pipelines_created, stats.creation_seconds,
+    100.0 * stats.hit_rate, stats.seconds_saved))
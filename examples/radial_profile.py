@@ -0,0 +1,46 @@
+from SnowfakePython import *
+import numpy as np
+
+# Radial profile of the diffusive mass in the seed plane, averaged over
+# angle, from a million points sampled in one call per snapshot.
+
+medium = Medium()
+medium.rho = 0.1
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+sim_params = SimulationParameters()
+sim_params.medium = medium
+sim_params.seed = seed_crystal
+sim_params.voxel_x_count = 128
+sim_params.voxel_y_count = 128
+sim_params.voxel_z_count = 64
+sim_params.steps_per_submit = 16
+sim_params.measurement_interval = 2000
+
+stop_step = 6000
+radii = np.linspace(0.0, 50.0, 51, dtype=np.float32)
+angles = np.linspace(0.0, 2.0 * np.pi, 20000, endpoint=False,
+  dtype=np.float32)
+
+r, theta = np.meshgrid(radii, angles, indexing='ij')
+points = np.stack([
+  (r * np.cos(theta)).ravel(),
+  (r * np.sin(theta)).ravel(),
+  np.zeros(r.size, dtype=np.float32)], axis=1).astype(np.float32)
+
+def measure_callback(sim_state: SimulationState,
+  time: float,
+  data):
+    diffusive_mass = sim_state.sample(points, occupancy=False,
+      boundary_mass=False)[0]
+    profile = diffusive_mass.reshape(len(radii), len(angles)).mean(axis=1)
+    print("step {:.0f}: ".format(time) +
+      " ".join("{:.3f}".format(v) for v in profile[::10]))
+    if (time >= stop_step):
+      Simulation.stop()
+
+Simulation.measurement(measure_callback, None)
+Simulation.run(sim_params)
@@ -0,0 +1,44 @@
+from SnowfakePython import *
+import time
+
+# Back-to-back runs of the same grid in one session reuse the Vulkan
+# context, memory allocations and compiled programs, so only the first run
+# pays for creating them.
+
+medium = Medium()
+medium.rho = 0.1
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+stop_step = 64
+
+def measure_callback(sim_state: SimulationState,
+  time: float,
+  data):
+    if (time >= stop_step):
+      Simulation.stop()
+
+Simulation.begin_session()
+try:
+  for run in range(4):
+    sim_params = SimulationParameters()
+    sim_params.medium = medium
+    sim_params.seed = seed_crystal
+    sim_params.voxel_x_count = 128
+    sim_params.voxel_y_count = 128
+    sim_params.voxel_z_count = 64
+    sim_params.measurement_interval = stop_step
+
+    Simulation.measurement(measure_callback, None)
+
+    start = time.perf_counter()
+    Simulation.run(sim_params)
+    elapsed = time.perf_counter() - start
+
+    stats = Simulation.pipeline_cache_statistics
+    print("run {:d}: {:.3f}s, {:d} pipelines created, {:d} reused".format(
+      run, elapsed, stats.pipelines_created, stats.programs_reused))
+finally:
+  Simulation.end_session()
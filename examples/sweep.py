@@ -0,0 +1,43 @@
+from SnowfakePython import *
+
+# A parameter sweep scheduled over every compute queue of every GPU. Each
+# result arrives as soon as its run finishes, with the final crystal
+# exported to an STL file.
+
+seed_crystal = SeedCrystal()
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+runs = []
+for rho in [0.08, 0.1, 0.12]:
+  for kappa in [0.005, 0.01, 0.05]:
+    medium = Medium()
+    medium.rho = rho
+    medium.kappa = kappa
+
+    sim_params = SimulationParameters()
+    sim_params.medium = medium
+    sim_params.seed = seed_crystal
+    sim_params.voxel_x_count = 128
+    sim_params.voxel_y_count = 128
+    sim_params.voxel_z_count = 64
+    sim_params.steps_per_submit = 8
+    sim_params.measurement_interval = 100
+    sim_params.diagnostics_interval = 100
+    runs.append(sim_params)
+
+stop_condition = SweepStopCondition()
+stop_condition.max_steps = 20000
+stop_condition.max_radius_t = 50
+
+def result_callback(result: SweepResult):
+  medium = result.parameters.medium
+  print("run {:d} (rho {:f}, kappa {:f}) on device {:d} queue {:d}: "
+    "{:d} steps".format(result.index, medium.rho, medium.kappa,
+      result.device, result.queue, result.steps))
+  if result.completed:
+    result.state().exportSTL("sweep_{:d}.stl".format(result.index))
+
+sweep = Sweep()
+sweep.run(runs, stop_condition, result_callback)
+print("{:d} runs on {:d} queues".format(len(runs), sweep.worker_count))
@@ -0,0 +1,59 @@
+from SnowfakePython import *
+from math import *
+import sys
+import time
+
+# Compares the full domain against its D6h symmetry-reduced wedge, which
+# stores and updates 1/24 of the voxels. Occupancy should agree, masses up to
+# floating point rounding.
+
+medium = Medium()
+medium.rho = 0.1
+medium.kappa = 0.1
+medium.mu = 0.001
+
+seed_crystal = SeedCrystal()
+# The z mirror needs a seed of odd thickness.
+seed_crystal.thickness = 1
+seed_crystal.radius = 2
+
+stop_step = 2000
+
+class MeasurementData:
+  def __init__(self, stoptime : int):
+    self.stop_time = stoptime
+    self.profile = []
+    pass
+
+def measure_callback(sim_state: SimulationState,
+  time: float,
+  data: MeasurementData):
+    if (time >= data.stop_time):
+      data.profile = [sim_state.occupancy(i, 0, 0) for i in range(-60, 61)]
+      Simulation.stop()
+
+for symmetry in [SymmetryMode.NONE, SymmetryMode.D6H]:
+  sim_params = SimulationParameters()
+  sim_params.medium = medium
+  sim_params.seed = seed_crystal
+  sim_params.voxel_x_count = 256
+  sim_params.voxel_y_count = 256
+  sim_params.voxel_z_count = 128
+  sim_params.steps_per_submit = 16
+  sim_params.measurement_interval = stop_step
+  sim_params.diagnostics_interval = stop_step
+  sim_params.symmetry = symmetry
+
+  measurement_data = MeasurementData(stop_step)
+  Simulation.measurement(measure_callback, measurement_data)
+
+  start = time.perf_counter()
+  Simulation.run(sim_params)
+  elapsed = time.perf_counter() - start
+
+  diagnostics = Simulation.diagnostics
+  print("{:s}: {:.2f}s, {:d} occupied voxels, {:f} total mass".format(
+    str(symmetry), elapsed,
+    diagnostics[-1].occupied_voxels,
+    diagnostics[-1].diffusive_mass + diagnostics[-1].boundary_mass))
+  print("".join("#" if v > 0.0 else "." for v in measurement_data.profile))
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstdint>
+
+#include "constants.h"
+#include "SimulationParameters.h"
+#include "ReadbackRegion.hpp"
+
+// Grids of adaptive growth, from a small grid around the seed up to the voxel
+// counts of the simulation parameters. Each grid is centred on the same
+// voxel, so fields carry over by an offset.
+struct AdaptiveGrid
+{
+public:
+  // Voxel count of a grid dimension with at least the given domain radius.
+  static int voxel_count(int iradius)
+  {
+    const int count = 2 * (iradius + 1 + BOUNDARY_THICKNESS);
+    return
+      (((count - 1) / GROWTH_GRANULARITY) + 1) * GROWTH_GRANULARITY;
+  }
+
+  // Parameters of the first grid, the seed with twice the growth margin
+  // around it. Fields are copied back whole and the readback region is
+  // applied on the host.
+  static SimulationParameters initial(
+    SimulationParameters const &final_parameters)
+  {
+    SimulationParameters grid_parameters = final_parameters;
+
+    const int margin = 2 * final_parameters.growthMargin();
+    const int count_T =
+      voxel_count(final_parameters.seed().radius() + margin);
+    const int count_Z =
+      voxel_count((final_parameters.seed().thickness() / 2) + margin);
+    grid_parameters.setVoxelXCount(
+      clamp_count(count_T, final_parameters.voxelXCount()));
+    grid_parameters.setVoxelYCount(
+      clamp_count(count_T, final_parameters.voxelYCount()));
+    grid_parameters.setVoxelZCount(
+      clamp_count(count_Z, final_parameters.voxelZCount()));
+
+    grid_parameters.setReadback(ReadbackRegion());
+    if (grid_parameters.diagnosticsInterval() == 0)
+    {
+      grid_parameters.setDiagnosticsInterval(GROWTH_CHECK_INTERVAL);
+    }
+    return grid_parameters;
+  }
+
+  static SimulationParameters grown(
+    SimulationParameters const &grid_parameters,
+    SimulationParameters const &final_parameters,
+    bool igrow_T, bool igrow_Z)
+  {
+    SimulationParameters grown_parameters = grid_parameters;
+    if (igrow_T)
+    {
+      grown_parameters.setVoxelXCount(clamp_count(
+        grown_count(grid_parameters.voxelXCount()),
+        final_parameters.voxelXCount()));
+      grown_parameters.setVoxelYCount(clamp_count(
+        grown_count(grid_parameters.voxelYCount()),
+        final_parameters.voxelYCount()));
+    }
+    if (igrow_Z)
+    {
+      grown_parameters.setVoxelZCount(clamp_count(
+        grown_count(grid_parameters.voxelZCount()),
+        final_parameters.voxelZCount()));
+    }
+    return grown_parameters;
+  }
+
+  static bool can_grow_T(
+    SimulationParameters const &grid_parameters,
+    SimulationParameters const &final_parameters)
+  {
+    return
+      (grid_parameters.voxelXCount() < final_parameters.voxelXCount()) ||
+      (grid_parameters.voxelYCount() < final_parameters.voxelYCount());
+  }
+
+  static bool can_grow_Z(
+    SimulationParameters const &grid_parameters,
+    SimulationParameters const &final_parameters)
+  {
+    return grid_parameters.voxelZCount() < final_parameters.voxelZCount();
+  }
+
+  // Copy the domain of full fields on one grid into the readback region of
+  // another, in its compact layout. Voxels outside the source domain, its
+  // ghost shell included, take quiescent values.
+  static void embed(
+    float const *src_fields, SimulationParameters const &src_parameters,
+    float *dst_fields, SimulationParameters const &dst_parameters,
+    ReadbackRegion const &readback,
+    float const (&quiescent)[SOLVER_FIELD_COUNT])
+  {
+    const int src_counts[3] = {
+      src_parameters.voxelXCount(),
+      src_parameters.voxelYCount(),
+      src_parameters.voxelZCount()
+    };
+    const int dst_counts[3] = {
+      dst_parameters.voxelXCount(),
+      dst_parameters.voxelYCount(),
+      dst_parameters.voxelZCount()
+    };
+    int begin[3], end[3];
+    readback.resolve(dst_counts, begin, end);
+
+    const int R = src_parameters.radiusT();
+    const int RZ = src_parameters.radiusZ();
+    const uintmax_t src_per_field_size =
+      uintmax_t(src_counts[0]) * uintmax_t(src_counts[1]) *
+        uintmax_t(src_counts[2]);
+
+    uintmax_t e = 0;
+    for (int m = 0; m < SOLVER_FIELD_COUNT; m++)
+    {
+      if (!readback.field(m)) continue;
+
+      for (int k = begin[2]; k < end[2]; k++)
+      {
+        const int bk = k - (dst_counts[2] / 2);
+        for (int j = begin[1]; j < end[1]; j++)
+        {
+          const int bj = j - (dst_counts[1] / 2);
+          for (int i = begin[0]; i < end[0]; i++)
+          {
+            const int bi = i - (dst_counts[0] / 2);
+
+            const bool outside_radius_condition =
+              ((-(bi+bj)) > R) || ((-bi) > R) || ((-bj) > R) ||
+              ((bi+bj) >= R) || (bi >= R) || (bj >= R) ||
+              ((-bk) > RZ) || (bk >= RZ);
+
+            dst_fields[e++] = (outside_radius_condition) ?
+              quiescent[m] :
+              src_fields[
+                uintmax_t(m) * src_per_field_size +
+                (uintmax_t(bk + (src_counts[2] / 2)) *
+                  uintmax_t(src_counts[1]) +
+                  uintmax_t(bj + (src_counts[1] / 2))) *
+                  uintmax_t(src_counts[0]) +
+                uintmax_t(bi + (src_counts[0] / 2))];
+          } // i
+        } // j
+      } // k
+    } // m
+  }
+
+private:
+  static int grown_count(int icount)
+  {
+    const int count =
+      ((icount * GROWTH_NUMERATOR) + GROWTH_DENOMINATOR - 1) /
+        GROWTH_DENOMINATOR;
+    return
+      (((count - 1) / GROWTH_GRANULARITY) + 1) * GROWTH_GRANULARITY;
+  }
+
+  static int clamp_count(int icount, int imaximum)
+  {
+    return (icount > imaximum) ? imaximum : icount;
+  }
+};
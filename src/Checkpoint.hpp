@@ -0,0 +1,418 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <unistd.h>
+
+#include "constants.h"
+#include "SimulationParameters.h"
+
+#define CHECKPOINT_MAGIC "SNOWCKPT"
+#define CHECKPOINT_VERSION 5
+
+// The state a simulation resumes from: the parameters it was started with,
+// the voxel counts of the grid it had reached, the next step to simulate and
+// the raw fields of that grid, every member of an ensemble in turn.
+struct Checkpoint
+{
+public:
+  Checkpoint()
+    : step(0)
+  {
+    for (int d = 0; d < 3; d++) voxel_counts[d] = 0;
+  }
+
+  SimulationParameters parameters;
+  int voxel_counts[3];
+  uintmax_t step;
+  std::vector<float> fields;
+
+  uintmax_t field_element_count() const
+  {
+    const int members = parameters.ensembleSize();
+    return
+      uintmax_t(voxel_counts[0]) * uintmax_t(voxel_counts[1]) *
+      uintmax_t(voxel_counts[2]) * SOLVER_FIELD_COUNT *
+      uintmax_t((members > 0) ? members : 1);
+  }
+
+  // Written to a temporary file that is flushed to disk before it replaces
+  // the checkpoint file, which therefore always holds a whole checkpoint.
+  bool save(std::string const &filename) const
+  {
+    const std::string temporary_filename = filename + ".tmp";
+    FILE *file = fopen(temporary_filename.c_str(), "wb");
+    if (file == nullptr) return false;
+
+    bool written = write(file);
+    written = (fflush(file) == 0) && written;
+    written = (fsync(fileno(file)) == 0) && written;
+    written = (fclose(file) == 0) && written;
+    if (!written)
+    {
+      std::remove(temporary_filename.c_str());
+      return false;
+    }
+    return (std::rename(temporary_filename.c_str(), filename.c_str()) == 0);
+  }
+
+  bool load(std::string const &filename)
+  {
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (file == nullptr) return false;
+
+    const bool read_whole = read(file);
+    fclose(file);
+    return read_whole;
+  }
+
+private:
+  static_assert(std::is_trivially_copyable<Medium>::value &&
+    std::is_trivially_copyable<SeedCrystal>::value &&
+    std::is_trivially_copyable<ReadbackRegion>::value,
+    "Checkpoints store media, seeds and readback regions as they are.");
+
+  template <typename T>
+  static bool write_value(FILE *file, T const &value)
+  {
+    return (fwrite(&value, sizeof(T), 1, file) == 1);
+  }
+
+  template <typename T>
+  static bool read_value(FILE *file, T &value)
+  {
+    return (fread(&value, sizeof(T), 1, file) == 1);
+  }
+
+  static bool write_string(FILE *file, std::string const &value)
+  {
+    return write_value(file, uint64_t(value.size())) &&
+      (fwrite(value.data(), 1, value.size(), file) == value.size());
+  }
+
+  // Bytes left to read in the file. Sizes and counts read from a file are
+  // checked against it before anything is allocated for them, so a corrupt
+  // checkpoint is refused rather than exhausting memory.
+  static uint64_t remaining_size(FILE *file)
+  {
+    const off_t position = ftello(file);
+    if ((position < 0) || (fseeko(file, 0, SEEK_END) != 0)) return 0;
+    const off_t end = ftello(file);
+    if ((fseeko(file, position, SEEK_SET) != 0) || (end < position))
+      return 0;
+    return uint64_t(end - position);
+  }
+
+  static bool read_string(FILE *file, std::string &value)
+  {
+    uint64_t size = 0;
+    if (!read_value(file, size) || (size > remaining_size(file)))
+      return false;
+    value.resize(size);
+    return (fread(&(value[0]), 1, size, file) == size);
+  }
+
+  bool write(FILE *file) const
+  {
+    std::vector<Medium> const &media = parameters.ensembleMedia();
+    std::vector<Medium> const &fork_media = parameters.forkMedia();
+    MediumSchedule const &medium_schedule = parameters.mediumSchedule();
+
+    bool written =
+      (fwrite(CHECKPOINT_MAGIC, 1, 8, file) == 8) &&
+      write_value(file, uint32_t(CHECKPOINT_VERSION)) &&
+      write_value(file, parameters.medium()) &&
+      write_value(file, parameters.seed()) &&
+      write_value(file, parameters.readback()) &&
+      write_value(file, int32_t(parameters.voxelXCount())) &&
+      write_value(file, int32_t(parameters.voxelYCount())) &&
+      write_value(file, int32_t(parameters.voxelZCount())) &&
+      write_value(file, int32_t(parameters.stepsPerSubmit())) &&
+      write_value(file, int32_t(parameters.measurementInterval())) &&
+      write_value(file, int32_t(parameters.diagnosticsInterval())) &&
+      write_value(file, int32_t(parameters.solverKernel())) &&
+      write_value(file, int32_t(parameters.temporalBlockingSteps())) &&
+      write_value(file, int32_t(parameters.symmetry())) &&
+      write_value(file, uint8_t(parameters.adaptiveGrowth())) &&
+      write_value(file, int32_t(parameters.growthMargin())) &&
+      write_value(file, parameters.growthDepletionTolerance()) &&
+      write_string(file, parameters.pipelineCacheFile()) &&
+      write_string(file, parameters.checkpointFile()) &&
+      write_value(file, int32_t(parameters.checkpointInterval())) &&
+      write_value(file, uint64_t(media.size()));
+    for (size_t m = 0; written && (m < media.size()); m++)
+    {
+      written = write_value(file, media[m]);
+    } // m
+    written = written &&
+      write_value(file, int32_t(parameters.forkStep())) &&
+      write_value(file, uint64_t(fork_media.size()));
+    for (size_t m = 0; written && (m < fork_media.size()); m++)
+    {
+      written = write_value(file, fork_media[m]);
+    } // m
+    written = written &&
+      write_value(file, int32_t(parameters.mediumMode())) &&
+      write_value(file, uint64_t(medium_schedule.size()));
+    for (size_t c = 0; written && (c < medium_schedule.size()); c++)
+    {
+      written =
+        write_value(file, int32_t(medium_schedule.steps()[c])) &&
+        write_value(file, medium_schedule.media()[c]);
+    } // c
+
+    written = written &&
+      write_value(file, int32_t(parameters.measurementDepth())) &&
+      write_value(file, int32_t(parameters.measurementBackpressure())) &&
+      write_value(file, int32_t(parameters.fieldLayout())) &&
+      write_value(file, int32_t(voxel_counts[0])) &&
+      write_value(file, int32_t(voxel_counts[1])) &&
+      write_value(file, int32_t(voxel_counts[2])) &&
+      write_value(file, uint64_t(step)) &&
+      write_value(file, uint64_t(fields.size())) &&
+      (fwrite(fields.data(), sizeof(float), fields.size(), file) ==
+        fields.size());
+    return written;
+  }
+
+  bool read(FILE *file)
+  {
+    char magic[8];
+    uint32_t version = 0;
+    if ((fread(magic, 1, 8, file) != 8) ||
+      (std::memcmp(magic, CHECKPOINT_MAGIC, 8) != 0) ||
+      !read_value(file, version) || (version != CHECKPOINT_VERSION))
+    {
+      return false;
+    }
+
+    Medium medium;
+    SeedCrystal seed;
+    ReadbackRegion readback;
+    int32_t x_size, y_size, z_size;
+    int32_t steps_per_submit, measurement_interval, diagnostics_interval;
+    int32_t solver_kernel, temporal_blocking_steps, symmetry;
+    uint8_t adaptive_growth;
+    int32_t growth_margin;
+    double growth_depletion_tolerance;
+    std::string pipeline_cache_file, checkpoint_file;
+    int32_t checkpoint_interval;
+    uint64_t media_count;
+    if (!(read_value(file, medium) &&
+      read_value(file, seed) &&
+      read_value(file, readback) &&
+      read_value(file, x_size) &&
+      read_value(file, y_size) &&
+      read_value(file, z_size) &&
+      read_value(file, steps_per_submit) &&
+      read_value(file, measurement_interval) &&
+      read_value(file, diagnostics_interval) &&
+      read_value(file, solver_kernel) &&
+      read_value(file, temporal_blocking_steps) &&
+      read_value(file, symmetry) &&
+      read_value(file, adaptive_growth) &&
+      read_value(file, growth_margin) &&
+      read_value(file, growth_depletion_tolerance) &&
+      read_string(file, pipeline_cache_file) &&
+      read_string(file, checkpoint_file) &&
+      read_value(file, checkpoint_interval) &&
+      read_value(file, media_count)))
+    {
+      return false;
+    }
+    if ((x_size <= 0) || (y_size <= 0) || (z_size <= 0) ||
+      (media_count > (remaining_size(file) / sizeof(Medium))))
+    {
+      return false;
+    }
+    std::vector<Medium> media(media_count);
+    for (size_t m = 0; m < media.size(); m++)
+    {
+      if (!read_value(file, media[m])) return false;
+    } // m
+    int32_t fork_step;
+    uint64_t fork_media_count;
+    if (!(read_value(file, fork_step) &&
+      read_value(file, fork_media_count)) ||
+      (fork_media_count > (remaining_size(file) / sizeof(Medium))))
+    {
+      return false;
+    }
+    std::vector<Medium> fork_media(fork_media_count);
+    for (size_t m = 0; m < fork_media.size(); m++)
+    {
+      if (!read_value(file, fork_media[m])) return false;
+    } // m
+    int32_t medium_mode;
+    uint64_t medium_change_count;
+    if (!(read_value(file, medium_mode) &&
+      read_value(file, medium_change_count)) ||
+      (medium_change_count >
+        (remaining_size(file) / (sizeof(int32_t) + sizeof(Medium)))))
+    {
+      return false;
+    }
+    MediumSchedule medium_schedule;
+    for (uint64_t c = 0; c < medium_change_count; c++)
+    {
+      int32_t change_step;
+      Medium change_medium;
+      if (!(read_value(file, change_step) &&
+        read_value(file, change_medium)))
+      {
+        return false;
+      }
+      medium_schedule.add(change_step, change_medium);
+    } // c
+    int32_t measurement_depth, measurement_backpressure, field_layout;
+    if (!(read_value(file, measurement_depth) &&
+      read_value(file, measurement_backpressure) &&
+      read_value(file, field_layout)))
+    {
+      return false;
+    }
+
+    parameters = SimulationParameters(medium);
+    parameters.setSeed(seed);
+    parameters.setReadback(readback);
+    parameters.setVoxelXCount(x_size);
+    parameters.setVoxelYCount(y_size);
+    parameters.setVoxelZCount(z_size);
+    parameters.setStepsPerSubmit(steps_per_submit);
+    parameters.setMeasurementInterval(measurement_interval);
+    parameters.setDiagnosticsInterval(diagnostics_interval);
+    parameters.setSolverKernel(static_cast<SolverKernel>(solver_kernel));
+    parameters.setTemporalBlockingSteps(temporal_blocking_steps);
+    parameters.setSymmetry(static_cast<SymmetryMode>(symmetry));
+    parameters.setAdaptiveGrowth(adaptive_growth != 0);
+    parameters.setGrowthMargin(growth_margin);
+    parameters.setGrowthDepletionTolerance(growth_depletion_tolerance);
+    parameters.setPipelineCacheFile(pipeline_cache_file);
+    parameters.setCheckpointFile(checkpoint_file);
+    parameters.setCheckpointInterval(checkpoint_interval);
+    parameters.setEnsembleMedia(media);
+    parameters.setForkStep(fork_step);
+    parameters.setForkMedia(fork_media);
+    parameters.setMediumMode(static_cast<MediumMode>(medium_mode));
+    parameters.setMediumSchedule(medium_schedule);
+    parameters.setMeasurementDepth(measurement_depth);
+    parameters.setMeasurementBackpressure(
+      static_cast<MeasurementBackpressure>(measurement_backpressure));
+    parameters.setFieldLayout(static_cast<FieldLayout>(field_layout));
+
+    int32_t counts[3];
+    uint64_t saved_step, element_count;
+    if (!(read_value(file, counts[0]) &&
+      read_value(file, counts[1]) &&
+      read_value(file, counts[2]) &&
+      read_value(file, saved_step) &&
+      read_value(file, element_count)))
+    {
+      return false;
+    }
+    // The element count must match the voxel counts, and the fields must
+    // fit in what is left of the file. Checked in steps, so neither the
+    // product nor its size in bytes can wrap.
+    const uint64_t available = remaining_size(file) / sizeof(float);
+    uint64_t expected = uint64_t(SOLVER_FIELD_COUNT) *
+      uint64_t((media.size() > 0) ? media.size() : 1);
+    for (int d = 0; d < 3; d++)
+    {
+      if ((counts[d] <= 0) || (expected > (available / uint64_t(counts[d]))))
+        return false;
+      expected *= uint64_t(counts[d]);
+    } // d
+    if (element_count != expected) return false;
+    for (int d = 0; d < 3; d++) voxel_counts[d] = counts[d];
+    step = saved_step;
+
+    fields.resize(element_count);
+    return (fread(fields.data(), sizeof(float), fields.size(), file) ==
+      fields.size());
+  }
+};
+
+// Writes checkpoints on a thread of its own, so the solver carries on while
+// they are flushed to disk. The simulation fills the checkpoint from the
+// staging memory of a download and hands it over, a checkpoint that falls
+// due while the previous one is still being written is skipped.
+class CheckpointWriter
+{
+public:
+  CheckpointWriter(std::string const &ifilename,
+    SimulationParameters const &iparameters)
+    : _filename(ifilename)
+    , _pending(false)
+    , _finishing(false)
+  {
+    _checkpoint.parameters = iparameters;
+    _thread = std::thread([this]() { write_loop(); });
+  }
+
+  // Writes a checkpoint still pending before returning.
+  ~CheckpointWriter()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _finishing = true;
+    }
+    _condition.notify_all();
+    _thread.join();
+  }
+
+  // The checkpoint to fill before submit(), nullptr while the previous one
+  // is still being written.
+  Checkpoint *acquire()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return (_pending) ? nullptr : &_checkpoint;
+  }
+
+  void submit()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _pending = true;
+    }
+    _condition.notify_all();
+  }
+
+private:
+  void write_loop()
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+      _condition.wait(lock, [this]() { return _pending || _finishing; });
+      if (!_pending) return;
+
+      lock.unlock();
+      if (!_checkpoint.save(_filename))
+      {
+        fprintf(stderr, "Could not write the checkpoint to %s.\n",
+          _filename.c_str());
+      }
+      lock.lock();
+
+      _pending = false;
+    }
+  }
+
+  std::string _filename;
+  Checkpoint _checkpoint;
+  bool _pending;
+  bool _finishing;
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  std::thread _thread;
+};
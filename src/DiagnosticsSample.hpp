@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "constants.h"
+
+// Scalar diagnostics of the simulated domain after one solver step, reduced
+// on the GPU.
+struct DiagnosticsSample
+{
+public:
+  DiagnosticsSample()
+    : _step(0)
+    , _occupied_voxels(0)
+    , _diffusive_mass(0.0)
+    , _boundary_mass(0.0)
+    , _max_radius_t(0)
+    , _max_radius_z(0)
+    , _attached_voxels(0)
+    , _depleted_radius_t(0)
+    , _depleted_radius_z(0)
+  {
+  }
+
+  // Unpack one DIAGNOSTICS_RECORD_WORDS record as written by
+  // reduce_diagnostics.comp.
+  DiagnosticsSample(uintmax_t istep, uint32_t const *record)
+    : _step(istep)
+  {
+    float diffusive_mass, boundary_mass;
+    std::memcpy(&diffusive_mass, &(record[1]), sizeof(float));
+    std::memcpy(&boundary_mass, &(record[2]), sizeof(float));
+
+    _occupied_voxels = record[0];
+    _diffusive_mass = diffusive_mass;
+    _boundary_mass = boundary_mass;
+    _max_radius_t = static_cast<int>(record[3]);
+    _max_radius_z = static_cast<int>(record[4]);
+    _attached_voxels = record[5];
+    _depleted_radius_t = static_cast<int>(record[6]);
+    _depleted_radius_z = static_cast<int>(record[7]);
+  }
+
+  uintmax_t step() const { return _step; }
+  uint64_t occupied_voxels() const { return _occupied_voxels; }
+  double diffusive_mass() const { return _diffusive_mass; }
+  double boundary_mass() const { return _boundary_mass; }
+  int max_radius_t() const { return _max_radius_t; }
+  int max_radius_z() const { return _max_radius_z; }
+  uint64_t attached_voxels() const { return _attached_voxels; }
+  int depleted_radius_t() const { return _depleted_radius_t; }
+  int depleted_radius_z() const { return _depleted_radius_z; }
+
+private:
+  uintmax_t _step;
+  uint64_t _occupied_voxels;
+  double _diffusive_mass;
+  double _boundary_mass;
+  int _max_radius_t;
+  int _max_radius_z;
+  uint64_t _attached_voxels;
+  int _depleted_radius_t;
+  int _depleted_radius_z;
+};
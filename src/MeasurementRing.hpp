@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "SimulationParameters.h"
+
+// Measures the snapshots of the fields downloaded for measurement on a thread
+// of its own, so the solver carries on while the measurement callback runs.
+// The simulation acquires a free slot for a submission to download into, and
+// submits the slot once the download has completed. Slots are measured in
+// the order they were submitted, and are free again once measured.
+class MeasurementRing
+{
+public:
+  MeasurementRing(unsigned int idepth,
+    MeasurementBackpressure ibackpressure,
+    void (*imeasure)(
+      unsigned int slot,
+      uintmax_t timestep,
+      void *user_pointer),
+    void *imeasure__user_pointer)
+    : _free(idepth, true)
+    , _backpressure(ibackpressure)
+    , _measure(imeasure)
+    , _measure__user_pointer(imeasure__user_pointer)
+    , _measuring(false)
+    , _finishing(false)
+    , _dropped(0)
+  {
+    _thread = std::thread([this]() { measure_loop(); });
+  }
+
+  // Measures the slots still submitted before returning.
+  ~MeasurementRing()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _finishing = true;
+    }
+    _condition.notify_all();
+    _thread.join();
+  }
+
+  unsigned int depth() const
+  {
+    return static_cast<unsigned int>(_free.size());
+  }
+
+  // A free slot to download into, -1 to skip the measurement when none is
+  // free and the backpressure drops it. Blocking only waits for slots
+  // submitted for measurement, so fewer than depth() slots may be acquired
+  // and not submitted yet at any time.
+  int acquire()
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (_backpressure == MeasurementBackpressure::BLOCK)
+    {
+      _condition.wait(lock, [this]() { return free_slot() >= 0; });
+    }
+    const int slot = free_slot();
+    if (slot < 0)
+    {
+      _dropped++;
+      return -1;
+    }
+    _free[slot] = false;
+    return slot;
+  }
+
+  // The download into the acquired slot has completed, measure it as the
+  // fields at the timestep.
+  void submit(int slot, uintmax_t timestep)
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _submitted.emplace_back(static_cast<unsigned int>(slot), timestep);
+    }
+    _condition.notify_all();
+  }
+
+  // Waits until every slot submitted has been measured.
+  void drain()
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _condition.wait(lock,
+      [this]() { return _submitted.empty() && !_measuring; });
+  }
+
+  // Measurements skipped so far for want of a free slot.
+  uintmax_t dropped() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _dropped;
+  }
+
+private:
+  int free_slot() const
+  {
+    for (size_t s = 0; s < _free.size(); s++)
+    {
+      if (_free[s]) return static_cast<int>(s);
+    } // s
+    return -1;
+  }
+
+  void measure_loop()
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+      _condition.wait(lock,
+        [this]() { return !_submitted.empty() || _finishing; });
+      if (_submitted.empty()) return;
+
+      const std::pair<unsigned int, uintmax_t> next = _submitted.front();
+      _submitted.pop_front();
+      _measuring = true;
+
+      lock.unlock();
+      (*_measure)(next.first, next.second, _measure__user_pointer);
+      lock.lock();
+
+      _measuring = false;
+      _free[next.first] = true;
+      _condition.notify_all();
+    }
+  }
+
+  std::vector<bool> _free;
+  std::deque<std::pair<unsigned int, uintmax_t> > _submitted;
+  MeasurementBackpressure _backpressure;
+  void (*_measure)(
+    unsigned int slot,
+    uintmax_t timestep,
+    void *user_pointer);
+  void *_measure__user_pointer;
+  bool _measuring;
+  bool _finishing;
+  uintmax_t _dropped;
+  mutable std::mutex _mutex;
+  std::condition_variable _condition;
+  std::thread _thread;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Medium.hpp"
+
+// Piecewise constant medium over the steps of a simulation: each change
+// takes effect from its step on, until the next one. Before the first change
+// the medium of the simulation parameters applies. Only kappa, mu and beta
+// of a change matter, rho and phi only shape the initial fields.
+struct MediumSchedule
+{
+public:
+  MediumSchedule()
+  {
+  }
+
+  // Changes are kept in step order, a change at a step already scheduled
+  // replaces it.
+  void add(int istep, Medium const &imedium)
+  {
+    const int step = (istep < 0) ? 0 : istep;
+    size_t c = 0;
+    while ((c < _steps.size()) && (_steps[c] < step)) c++;
+    if ((c < _steps.size()) && (_steps[c] == step))
+    {
+      _media[c] = imedium;
+      return;
+    }
+    _steps.insert(_steps.begin() + c, step);
+    _media.insert(_media.begin() + c, imedium);
+  }
+
+  void clear()
+  {
+    _steps.clear();
+    _media.clear();
+  }
+
+  bool empty() const { return _steps.empty(); }
+  size_t size() const { return _steps.size(); }
+
+  std::vector<int> const &steps() const { return _steps; }
+  std::vector<Medium> const &media() const { return _media; }
+
+  // The medium in effect at the step, initial before the first change.
+  Medium const &at(uintmax_t step, Medium const &initial) const
+  {
+    Medium const *medium = &initial;
+    for (size_t c = 0; (c < _steps.size()) &&
+      (uintmax_t(_steps[c]) <= step); c++)
+    {
+      medium = &(_media[c]);
+    } // c
+    return *medium;
+  }
+
+private:
+  std::vector<int> _steps;
+  std::vector<Medium> _media;
+};
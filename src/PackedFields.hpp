@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "constants.h"
+#include "SimulationParameters.h"
+#include "ReadbackRegion.hpp"
+
+// Storage of FieldLayout::PACKED, in 32-bit words: the diffusive and boundary
+// mass of each voxel side by side, followed by the occupancy of the voxels
+// packed 32 to a word, lowest bit first. Matches the packed field accessors
+// of solver_substep.comp.
+struct PackedFields
+{
+public:
+  PackedFields(int ix_size, int iy_size, int iz_size)
+    : _x_size(ix_size)
+    , _y_size(iy_size)
+    , _z_size(iz_size)
+  {
+  }
+
+  explicit PackedFields(SimulationParameters const &simulation_parameters)
+    : PackedFields(
+      simulation_parameters.voxelXCount(),
+      simulation_parameters.voxelYCount(),
+      simulation_parameters.voxelZCount())
+  {
+  }
+
+  // Whether the simulation stores the packed layout, only the direct solver
+  // kernel reads it. Forks copy the planar layout into their branches.
+  static bool enabled(SimulationParameters const &simulation_parameters)
+  {
+    return
+      (simulation_parameters.fieldLayout() == FieldLayout::PACKED) &&
+      (simulation_parameters.symmetry() == SymmetryMode::NONE) &&
+      (simulation_parameters.ensembleSize() == 0) &&
+      (!simulation_parameters.forks()) &&
+      (simulation_parameters.mediumMode() != MediumMode::PUSH_CONSTANTS) &&
+      (simulation_parameters.solverKernel() == SolverKernel::DIRECT);
+  }
+
+  uintmax_t per_field_size() const
+  {
+    return uintmax_t(_x_size) * uintmax_t(_y_size) * uintmax_t(_z_size);
+  }
+
+  // Word of the first occupancy bits.
+  uintmax_t occupancy_offset() const
+  {
+    return 2 * per_field_size();
+  }
+
+  uintmax_t size() const
+  {
+    return occupancy_offset() + ((per_field_size() + 31) / 32);
+  }
+
+  // Pack fields laid out over the full grid.
+  void pack(float const *all_fields, float *packed_fields) const
+  {
+    const uintmax_t n = per_field_size();
+    for (uintmax_t e = 0; e < n; e++)
+    {
+      packed_fields[2*e] = all_fields[FIELD_DIFFUSIVE_MASS*n + e];
+      packed_fields[2*e + 1] = all_fields[FIELD_BOUNDARY_MASS*n + e];
+    } // e
+
+    for (uintmax_t w = 0; w < (size() - occupancy_offset()); w++)
+    {
+      uint32_t word = 0;
+      for (uintmax_t e = 32*w; (e < n) && (e < (32*w + 32)); e++)
+      {
+        if (all_fields[FIELD_OCCUPANCY*n + e] > 0.f)
+        {
+          word |= (uint32_t(1) << (e & 31));
+        }
+      } // e
+      std::memcpy(&(packed_fields[occupancy_offset() + w]), &word,
+        sizeof(word));
+    } // w
+  }
+
+  // Unpack the readback region of the full grid, in its compact layout.
+  void unpack(float const *packed_fields, float *compact_fields,
+    ReadbackRegion const &readback) const
+  {
+    const int counts[3] = { _x_size, _y_size, _z_size };
+    int begin[3], end[3];
+    readback.resolve(counts, begin, end);
+
+    uintmax_t c = 0;
+    for (int m = 0; m < SOLVER_FIELD_COUNT; m++)
+    {
+      if (!readback.field(m)) continue;
+
+      for (int k = begin[2]; k < end[2]; k++)
+      {
+        for (int j = begin[1]; j < end[1]; j++)
+        {
+          for (int i = begin[0]; i < end[0]; i++)
+          {
+            const uintmax_t e =
+              (uintmax_t(k) * uintmax_t(_y_size) + uintmax_t(j)) *
+                uintmax_t(_x_size) +
+              uintmax_t(i);
+            if (m == FIELD_OCCUPANCY)
+            {
+              uint32_t word;
+              std::memcpy(&word,
+                &(packed_fields[occupancy_offset() + (e >> 5)]),
+                sizeof(word));
+              compact_fields[c++] = float((word >> (e & 31)) & 1);
+            } else
+            {
+              compact_fields[c++] = packed_fields[2*e +
+                ((m == FIELD_DIFFUSIVE_MASS) ? 0 : 1)];
+            }
+          } // i
+        } // j
+      } // k
+    } // m
+  }
+
+private:
+  int _x_size;
+  int _y_size;
+  int _z_size;
+};
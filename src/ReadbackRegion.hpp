@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "constants.h"
+
+// The fields and axis-aligned box of voxels copied back from the GPU for
+// measurement. The host copy is compact: each selected field in order, each
+// laid out z-major over the box only.
+struct ReadbackRegion
+{
+public:
+  ReadbackRegion()
+    : _field_mask((1 << SOLVER_FIELD_COUNT) - 1)
+  {
+    for (int d = 0; d < 3; d++)
+    {
+      _begin[d] = 0;
+      _end[d] = -1;
+    }
+  }
+
+  struct Copy
+  {
+    uintmax_t src_element;
+    uintmax_t dst_element;
+    uintmax_t element_count;
+  };
+
+  bool field(int m) const { return (_field_mask >> m) & 1; }
+  void set_field(int m, bool ienabled)
+  {
+    _field_mask = (ienabled) ?
+      (_field_mask | (1 << m)) : (_field_mask & ~(1 << m));
+  }
+
+  bool occupancy() const { return field(FIELD_OCCUPANCY); }
+  bool diffusive_mass() const { return field(FIELD_DIFFUSIVE_MASS); }
+  bool boundary_mass() const { return field(FIELD_BOUNDARY_MASS); }
+  void set_occupancy(bool ienabled) { set_field(FIELD_OCCUPANCY, ienabled); }
+  void set_diffusive_mass(bool ienabled)
+  {
+    set_field(FIELD_DIFFUSIVE_MASS, ienabled);
+  }
+  void set_boundary_mass(bool ienabled)
+  {
+    set_field(FIELD_BOUNDARY_MASS, ienabled);
+  }
+
+  // An end of -1 extends the box to the end of the grid in that dimension.
+  int x_begin() const { return _begin[0]; }
+  int y_begin() const { return _begin[1]; }
+  int z_begin() const { return _begin[2]; }
+  int x_end() const { return _end[0]; }
+  int y_end() const { return _end[1]; }
+  int z_end() const { return _end[2]; }
+  void set_x_begin(int ibegin) { _begin[0] = ibegin; }
+  void set_y_begin(int ibegin) { _begin[1] = ibegin; }
+  void set_z_begin(int ibegin) { _begin[2] = ibegin; }
+  void set_x_end(int iend) { _end[0] = iend; }
+  void set_y_end(int iend) { _end[1] = iend; }
+  void set_z_end(int iend) { _end[2] = iend; }
+
+  // Box clamped to a grid of the given voxel counts, as [begin, end).
+  void resolve(int const (&counts)[3], int (&begin)[3], int (&end)[3]) const
+  {
+    for (int d = 0; d < 3; d++)
+    {
+      begin[d] = (_begin[d] < 0) ? 0 :
+        ((_begin[d] > counts[d]) ? counts[d] : _begin[d]);
+      end[d] = ((_end[d] < 0) || (_end[d] > counts[d])) ? counts[d] : _end[d];
+      if (end[d] < begin[d]) end[d] = begin[d];
+    }
+  }
+
+  // Elements of the compact host copy from a grid of the given voxel counts.
+  uintmax_t element_count(int const (&counts)[3]) const
+  {
+    int begin[3], end[3];
+    resolve(counts, begin, end);
+
+    uintmax_t count = 0;
+    for (int m = 0; m < SOLVER_FIELD_COUNT; m++)
+    {
+      if (!field(m)) continue;
+      count +=
+        uintmax_t(end[0] - begin[0]) * uintmax_t(end[1] - begin[1]) *
+          uintmax_t(end[2] - begin[2]);
+    } // m
+    return count;
+  }
+
+  bool is_full(int x_size, int y_size, int z_size) const
+  {
+    const int counts[3] = { x_size, y_size, z_size };
+    int begin[3], end[3];
+    resolve(counts, begin, end);
+
+    return
+      (_field_mask == ((1 << SOLVER_FIELD_COUNT) - 1)) &&
+      (begin[0] == 0) && (end[0] == x_size) &&
+      (begin[1] == 0) && (end[1] == y_size) &&
+      (begin[2] == 0) && (end[2] == z_size);
+  }
+
+  // Minimal list of contiguous element copies from the full field layout
+  // into the compact layout, adjacent runs are merged.
+  std::vector<Copy> copies(int x_size, int y_size, int z_size) const
+  {
+    const int counts[3] = { x_size, y_size, z_size };
+    int begin[3], end[3];
+    resolve(counts, begin, end);
+
+    const uintmax_t per_field_size =
+      uintmax_t(x_size) * uintmax_t(y_size) * uintmax_t(z_size);
+    const uintmax_t run_length = uintmax_t(end[0] - begin[0]);
+
+    std::vector<Copy> runs;
+    if (run_length == 0) return runs;
+
+    uintmax_t dst_element = 0;
+    for (int m = 0; m < SOLVER_FIELD_COUNT; m++)
+    {
+      if (!field(m)) continue;
+
+      for (int k = begin[2]; k < end[2]; k++)
+      {
+        for (int j = begin[1]; j < end[1]; j++)
+        {
+          const uintmax_t src_element =
+            uintmax_t(m) * per_field_size +
+            (uintmax_t(k) * uintmax_t(y_size) + uintmax_t(j)) *
+              uintmax_t(x_size) +
+            uintmax_t(begin[0]);
+
+          if ((!runs.empty()) &&
+            ((runs.back().src_element + runs.back().element_count) ==
+              src_element) &&
+            ((runs.back().dst_element + runs.back().element_count) ==
+              dst_element))
+          {
+            runs.back().element_count += run_length;
+          } else
+          {
+            runs.push_back({ src_element, dst_element, run_length });
+          }
+          dst_element += run_length;
+
+        } // j
+
+      } // k
+
+    } // m
+
+    return runs;
+  }
+
+private:
+  int _field_mask;
+  int _begin[3];
+  int _end[3];
+};
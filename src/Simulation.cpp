@@ -2,9 +2,11 @@
 #include "aux_vulkan.h"
 #include "Simulation.hpp"
 
-void Simulation::perform_measurements(float *all_fields, double time) const
+void Simulation::perform_measurements(
+  float *all_fields, double time, int member, bool branch) const
 {
-  SimulationState sim_state(all_fields, *_simulation_parameters);
+  SimulationState sim_state(all_fields, *_simulation_parameters, member,
+    branch);
 
   if (data_collection_callback != nullptr)
   {
@@ -19,8 +21,104 @@ void Simulation::perform_measurements(float *all_fields, double time) const
 #if defined(SIMULATION_STUBS)
 // Cannot run simulation, functionality stubbed out.
 bool Simulation::simulation_run() { return false; }
+bool Simulation::start(SimulationParameters const &,
+  std::shared_ptr<vkch::Context> const &) { return false; }
 #else // defined(SIMULATION_STUBS)
 
+std::shared_ptr<vkch::Context> const &Simulation::shared_context()
+{
+  static std::mutex shared_context_mutex;
+  static std::shared_ptr<vkch::Context> shared_ctxt = nullptr;
+
+  std::lock_guard<std::mutex> lock(shared_context_mutex);
+
+  if (shared_ctxt == nullptr)
+  {
+    shared_ctxt =
+      vkch::Context::create(
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr
+      );
+  }
+  return shared_ctxt;
+}
+
+bool Simulation::start(SimulationParameters const &isimulation_parameters,
+  std::shared_ptr<vkch::Context> const &ivkch_ctxt)
+{
+  {
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
+
+    if (running)
+    {
+      fprintf(stderr, "Simulation already in progress...\n");
+      return false;
+    }
+
+    _simulation_parameters =
+      std::make_shared<SimulationParameters>(isimulation_parameters);
+    running = true;
+    finish_threads = 0;
+    _diagnostics.clear();
+    _host_seconds = 0.0;
+    _host_steps = 0;
+  }
+
+  // A finished run that was not waited for.
+  wait();
+
+  // Later runs of this instance reuse its allocations and programs that fit.
+  no_gui = true;
+  if (ivkch_ctxt != nullptr)
+  {
+    vkch_ctxt = ivkch_ctxt;
+  }
+  if (vkch_ctxt == nullptr)
+  {
+    vkch_ctxt = shared_context()->share();
+  }
+  vkch_ctxt->recycle();
+  vkch_ctxt->resetPipelineCacheStatistics();
+
+  const std::string &pipeline_cache_file =
+    _simulation_parameters->pipelineCacheFile();
+  if (!pipeline_cache_file.empty())
+  {
+    vkch_ctxt->loadPipelineCache(pipeline_cache_file);
+  }
+
+  compute_thread = std::thread(
+    [this]()
+    {
+      simulation_thread(*this,
+        &(finish_threads),
+        true,
+        nullptr,
+        vkch_ctxt,
+        *(_simulation_parameters.get()));
+
+      const std::string &pipeline_cache_file =
+        _simulation_parameters->pipelineCacheFile();
+      if ((!pipeline_cache_file.empty()) &&
+        (!vkch_ctxt->savePipelineCache(pipeline_cache_file)))
+      {
+        fprintf(stderr, "Could not save the pipeline cache to %s.\n",
+          pipeline_cache_file.c_str());
+      }
+
+      std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
+
+      _pipeline_cache_statistics = vkch_ctxt->pipelineCacheStatistics();
+      running = false;
+    }
+  );
+
+  return true;
+}
+
 bool Simulation::simulation_run()
 {
   aux_ctxt = std::make_shared<AuxiliaryVulkanContext>();
@@ -74,6 +172,7 @@ bool Simulation::simulation_run()
 
 #endif // else defined(NO_GUI)
 
+  const bool reuse_context = (vkch_ctxt != nullptr);
   if (vkch_ctxt == nullptr)
   {
     vkch_ctxt =
@@ -100,7 +199,26 @@ bool Simulation::simulation_run()
 #endif // !defined(NO_GUI)
 
   }
-  vkch_ctxt->clear();
+  // A session's context keeps its memory pool allocations and programs.
+  if (session_open)
+  {
+    vkch_ctxt->recycle();
+  } else
+  {
+    vkch_ctxt->clear();
+  }
+  vkch_ctxt->resetPipelineCacheStatistics();
+
+  const std::string &pipeline_cache_file =
+    _simulation_parameters->pipelineCacheFile();
+  if ((!reuse_context) && (!pipeline_cache_file.empty()) &&
+    (!vkch_ctxt->loadPipelineCache(pipeline_cache_file)))
+  {
+#if !defined(BUILD_PYTHON_BINDINGS)
+    fprintf(stderr, "No usable pipeline cache in %s, starting empty.\n",
+      pipeline_cache_file.c_str());
+#endif // !defined(BUILD_PYTHON_BINDINGS)
+  }
 
   finish_threads = 0;
 
@@ -134,7 +252,8 @@ bool Simulation::simulation_run()
   compute_thread = std::thread(
     [&]()
     {
-      simulation_thread(&(finish_threads),
+      simulation_thread(*this,
+        &(finish_threads),
         no_gui,
         volume_buffers,
         vkch_ctxt,
@@ -177,6 +296,33 @@ bool Simulation::simulation_run()
 
   vkch_ctxt->device().waitIdle();
 
+  if ((!pipeline_cache_file.empty()) &&
+    (!vkch_ctxt->savePipelineCache(pipeline_cache_file)))
+  {
+    fprintf(stderr, "Could not save the pipeline cache to %s.\n",
+      pipeline_cache_file.c_str());
+  }
+  {
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
+
+    _pipeline_cache_statistics = vkch_ctxt->pipelineCacheStatistics();
+  }
+#if !defined(BUILD_PYTHON_BINDINGS)
+  fprintf(stderr, "Created %u pipelines in %.3fs, reused %u, ",
+    _pipeline_cache_statistics.pipelines_created,
+    _pipeline_cache_statistics.creation_seconds,
+    _pipeline_cache_statistics.programs_reused);
+  if (_pipeline_cache_statistics.pipelines_with_feedback > 0)
+  {
+    fprintf(stderr, "%.0f%% pipeline cache hits, %.3fs saved.\n",
+      100.0 * _pipeline_cache_statistics.hitRate(),
+      _pipeline_cache_statistics.secondsSaved());
+  } else
+  {
+    fprintf(stderr, "pipeline cache hits not reported by the device.\n");
+  }
+#endif // !defined(BUILD_PYTHON_BINDINGS)
+
   persistent_gui = nullptr;
 
 #if !defined(NO_GUI)
@@ -192,7 +338,10 @@ bool Simulation::simulation_run()
 
   aux_ctxt = nullptr;
   volume_buffers = nullptr;
-  vkch_ctxt = nullptr;
+  if (!session_open)
+  {
+    vkch_ctxt = nullptr;
+  }
 
   return true;
 }
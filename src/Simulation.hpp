@@ -5,8 +5,11 @@
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include "Medium.hpp"
+#include "DiagnosticsSample.hpp"
+#include "Checkpoint.hpp"
 #include "SimulationState.h"
 
 #include "renderer/gui.h"
@@ -17,14 +20,309 @@
 class Simulation
 {
   friend void simulation_thread(
+    Simulation &simulation,
     volatile int *stop_thread,
     bool no_gui,
     const std::shared_ptr<VolumeBuffers> &volume_buffers,
     std::shared_ptr<vkch::Context> &vkch_ctxt,
     SimulationParameters const &simulation_parameters);
+  friend bool simulate_grid(
+    Simulation &simulation,
+    volatile int *stop_thread,
+    bool no_gui,
+    const std::shared_ptr<VolumeBuffers> &volume_buffers,
+    std::shared_ptr<vkch::Context> &vkch_ctxt,
+    SimulationParameters const &final_parameters,
+    SimulationParameters const &simulation_parameters,
+    uintmax_t &current_timestep,
+    std::vector<float> &grid_fields,
+    SimulationParameters &grown_parameters,
+    ForkedFields &forked_fields,
+    CheckpointWriter *checkpoint_writer);
 public:
+  // An independent simulation, started with start(). Instances run without
+  // the GUI, each on tensors, schemas and programs of its own within the
+  // Vulkan context shared by all instances, and submit to it concurrently.
+  Simulation()
+    : data_collection_callback(nullptr)
+    , data_collection_callback__user_pointer(nullptr)
+#if defined(NO_GUI)
+    , no_gui(true)
+#else // defined(NO_GUI)
+    , no_gui(false)
+#endif // else defined(NO_GUI)
+    , running(false)
+    , session_open(false)
+    , mtx_ptr(std::make_unique<std::mutex>())
+    , finish_threads(0)
+    , _simulation_parameters(nullptr)
+    , _resume_checkpoint(nullptr)
+    , _host_seconds(0.0)
+    , _host_steps(0)
+    , persistent_gui(nullptr)
+    , vkch_ctxt(nullptr)
+    , aux_ctxt(nullptr)
+    , volume_buffers(nullptr)
+  {}
+
+  inline ~Simulation()
+  {
+    finish();
+  }
+
+  // Start this instance's simulation on a thread of its own and return at
+  // once. Returns false if it is already running. It runs in the given
+  // context, from then on, or a context of its own on the shared device.
+  bool start(SimulationParameters const &isimulation_parameters,
+    std::shared_ptr<vkch::Context> const &ivkch_ctxt = nullptr);
+
+  // Wait for the simulation started by start() to finish.
+  inline void wait()
+  {
+    if (compute_thread.joinable())
+      compute_thread.join();
+  }
+
+  // Stop the simulation started by start() and wait for it to finish.
+  inline void finish()
+  {
+    if (compute_thread.joinable())
+    {
+      finish_threads = 1;
+      compute_thread.join();
+    }
+  }
+
+  // Ask the simulation to finish, e.g. from its measurement callback.
+  inline void request_stop()
+  {
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
+
+    if (!running)
+    {
+      fprintf(stderr, "Simulation not running.\n");
+      return;
+    }
+
+    finish_threads = 1;
+  }
+
+  // Ask one member of an ensemble to finish, the others carry on. The
+  // simulation finishes once every member has.
+  inline void request_member_stop(int member)
+  {
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
+
+    if (!running)
+    {
+      fprintf(stderr, "Simulation not running.\n");
+      return;
+    }
+
+    if ((member < 0) || (member >= int(_members_stopping.size())))
+    {
+      fprintf(stderr, "No ensemble member %d.\n", member);
+      return;
+    }
+
+    _members_stopping[member] = true;
+  }
+
+  inline bool is_running() const
+  {
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
+
+    return running;
+  }
+
+  // Returns false, keeping the current callback, while the simulation runs.
+  inline bool set_measurement(
+    void (*callback)(
+      SimulationState const &sim_state,
+      double time,
+      void *user_pointer),
+    void *callback__user_pointer
+  )
+  {
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
+
+    if (running)
+    {
+      fprintf(stderr, "Cannot change measurement function during "
+        "simulation.\n");
+      return false;
+    }
+
+    data_collection_callback = callback;
+    data_collection_callback__user_pointer = callback__user_pointer;
+    return true;
+  }
+
+  inline void *measurement_user_pointer() const
+  {
+    return data_collection_callback__user_pointer;
+  }
+
+  inline std::shared_ptr<SimulationParameters const> parameters() const
+  {
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
+
+    return _simulation_parameters;
+  }
+
+  // Time series of GPU reduced diagnostics of this instance's running or
+  // last run simulation.
+  inline std::vector<DiagnosticsSample> collected_diagnostics() const
+  {
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
+
+    return _diagnostics;
+  }
+
+  // The latest diagnostics sample, false if there is none yet.
+  inline bool latest_diagnostics(DiagnosticsSample &sample) const
+  {
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
+
+    if (_diagnostics.empty()) return false;
+    sample = _diagnostics.back();
+    return true;
+  }
+
+  inline vkch::PipelineCacheStatistics last_pipeline_cache_statistics() const
+  {
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
+
+    return _pipeline_cache_statistics;
+  }
+
+  // CPU time of the compute thread spent scheduling and submitting each
+  // solver step of this instance's running or last run simulation.
+  inline double host_seconds_per_step() const
+  {
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
+
+    return (_host_steps > 0) ? (_host_seconds / double(_host_steps)) : 0.0;
+  }
+
   inline static void run(
     SimulationParameters const &isimulation_parameters)
+  {
+    run_from(isimulation_parameters, nullptr);
+  }
+
+  // Continue the simulation saved in the checkpoint file, with the
+  // parameters it was started with, from the step after the checkpoint.
+  // Returns false if the file holds no whole checkpoint.
+  inline static bool resume(std::string const &checkpoint_file)
+  {
+    std::shared_ptr<Checkpoint> checkpoint = std::make_shared<Checkpoint>();
+    if (!checkpoint->load(checkpoint_file))
+    {
+      fprintf(stderr, "No usable checkpoint in %s.\n",
+        checkpoint_file.c_str());
+      return false;
+    }
+
+    run_from(checkpoint->parameters, checkpoint);
+    return true;
+  }
+
+  // Keep the Vulkan context, its memory pool allocations and its compiled
+  // programs between runs until end_session(). Each run then only
+  // reinitialises the field contents, reusing allocations and programs that
+  // fit.
+  inline static void begin_session()
+  {
+    Simulation &simulation = get();
+
+    std::lock_guard<std::mutex> lock(*(simulation.mtx_ptr.get()));
+
+    simulation.session_open = true;
+  }
+
+  inline static void end_session()
+  {
+    Simulation &simulation = get();
+
+    std::lock_guard<std::mutex> lock(*(simulation.mtx_ptr.get()));
+
+    if (simulation.running)
+    {
+      fprintf(stderr, "Cannot end the session during simulation.\n");
+      return;
+    }
+
+    simulation.session_open = false;
+    simulation.vkch_ctxt = nullptr;
+  }
+
+  inline static void stop()
+  {
+    get().request_stop();
+  }
+
+  inline static void stop_member(int member)
+  {
+    get().request_member_stop(member);
+  }
+
+  inline static bool measurement(
+    void (*callback)(
+      SimulationState const &sim_state,
+      double time,
+      void *user_pointer),
+    void *callback__user_pointer
+  )
+  {
+    return get().set_measurement(callback, callback__user_pointer);
+  }
+
+  inline static void *get_measurement_user_pointer()
+  {
+    return get().measurement_user_pointer();
+  }
+
+  inline static std::shared_ptr<SimulationParameters const> const &simulation_parameters()
+  {
+    Simulation &simulation = get();
+
+    return simulation._simulation_parameters;
+  }
+
+  // Time series of GPU reduced diagnostics of the running or last run
+  // simulation, one sample per diagnostics interval.
+  inline static std::vector<DiagnosticsSample> diagnostics()
+  {
+    return get().collected_diagnostics();
+  }
+
+  // Pipeline creation of the last run, through the pipeline cache.
+  inline static vkch::PipelineCacheStatistics pipeline_cache_statistics()
+  {
+    return get().last_pipeline_cache_statistics();
+  }
+
+  // Host CPU time per solver step of the running or last run simulation.
+  inline static double host_step_seconds()
+  {
+    return get().host_seconds_per_step();
+  }
+
+protected:
+  inline static Simulation &get()
+  {
+    static Simulation simulation;
+    return simulation;
+  }
+
+  bool simulation_run();
+
+  // Runs with the fields of the checkpoint, if any, instead of initialising
+  // them.
+  inline static void run_from(
+    SimulationParameters const &isimulation_parameters,
+    std::shared_ptr<Checkpoint> const &iresume_checkpoint)
   {
     Simulation &simulation = get();
 
@@ -43,6 +341,10 @@ public:
       }
 
       simulation.running = true;
+      simulation._diagnostics.clear();
+      simulation._host_seconds = 0.0;
+      simulation._host_steps = 0;
+      simulation._resume_checkpoint = iresume_checkpoint;
     }
 
     if (!simulation.simulation_run())
@@ -52,6 +354,7 @@ public:
       std::lock_guard<std::mutex> lock(*(simulation.mtx_ptr.get()));
 
       simulation.running = false;
+      simulation._resume_checkpoint = nullptr;
     }
 
 #if !defined(SIMULATION_STUBS)
@@ -62,72 +365,76 @@ public:
       //simulation._simulation_parameters = nullptr;
     }
 
+    // Diagnostics of the last run remain available after it ends.
+    std::vector<DiagnosticsSample> diagnostics =
+      std::move(simulation._diagnostics);
+    const vkch::PipelineCacheStatistics pipeline_cache_statistics =
+      simulation._pipeline_cache_statistics;
+    const double host_seconds = simulation._host_seconds;
+    const uintmax_t host_steps = simulation._host_steps;
+    // As does the context of an open session.
+    const bool session_open = simulation.session_open;
+    std::shared_ptr<vkch::Context> session_ctxt = simulation.vkch_ctxt;
     simulation = std::move(Simulation());
+    simulation._diagnostics = std::move(diagnostics);
+    simulation._pipeline_cache_statistics = pipeline_cache_statistics;
+    simulation._host_seconds = host_seconds;
+    simulation._host_steps = host_steps;
+    if (session_open)
+    {
+      simulation.session_open = true;
+      simulation.vkch_ctxt = session_ctxt;
+    }
 #endif // !defined(SIMULATION_STUBS)
   }
 
-  inline static void stop()
-  {
-    Simulation &simulation = get();
-
-    std::lock_guard<std::mutex> lock(*(simulation.mtx_ptr.get()));
 
-    if (!(simulation.running))
-    {
-      fprintf(stderr, "Simulation not running.\n");
-      return;
-    }
+  // Context whose device all instances share, each through a context of
+  // its own made by share().
+  static std::shared_ptr<vkch::Context> const &shared_context();
 
-    simulation.finish_threads = 1;
-  }
+  void perform_measurements(
+    float *all_fields, double time, int member = 0,
+    bool branch = false) const;
 
-  inline static void measurement(
-    void (*callback)(
-      SimulationState const &sim_state,
-      double time,
-      void *user_pointer),
-    void *callback__user_pointer
-  )
+  // Members of the ensemble about to run, none asked to stop yet.
+  inline void reset_members_stopping(int member_count)
   {
-    Simulation &simulation = get();
-
-    std::lock_guard<std::mutex> lock(*(simulation.mtx_ptr.get()));
-
-    if (simulation.running)
-    {
-      fprintf(stderr, "Cannot change measurement function during "
-        "simulation.\n");
-      return;
-    }
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
 
-    simulation.data_collection_callback = callback;
-    simulation.data_collection_callback__user_pointer = callback__user_pointer;
+    _members_stopping.assign(member_count, false);
   }
 
-  inline static void *get_measurement_user_pointer()
+  inline std::vector<bool> members_stopping() const
   {
-    Simulation &simulation = get();
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
 
-    return simulation.data_collection_callback__user_pointer;
+    return _members_stopping;
   }
 
-  inline static std::shared_ptr<SimulationParameters const> const &simulation_parameters()
+  // The checkpoint the run about to start resumes from, once.
+  inline std::shared_ptr<Checkpoint> take_resume_checkpoint()
   {
-    Simulation &simulation = get();
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
 
-    return simulation._simulation_parameters;
+    return std::move(_resume_checkpoint);
   }
 
-protected:
-  inline static Simulation &get()
+  inline void record_diagnostics(
+    std::vector<DiagnosticsSample> const &samples)
   {
-    static Simulation simulation;
-    return simulation;
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
+
+    _diagnostics.insert(_diagnostics.end(), samples.begin(), samples.end());
   }
 
-  bool simulation_run();
+  inline void record_host_time(double seconds, uintmax_t steps)
+  {
+    std::lock_guard<std::mutex> lock(*(mtx_ptr.get()));
 
-  void perform_measurements(float *all_fields, double time) const;
+    _host_seconds += seconds;
+    _host_steps += steps;
+  }
 
   Simulation(Simulation &&other) = default;
   Simulation &operator=(Simulation &&other) = default;
@@ -143,27 +450,20 @@ protected:
   void *data_collection_callback__user_pointer;
 
 private:
-  Simulation()
-    : data_collection_callback(nullptr)
-    , data_collection_callback__user_pointer(nullptr)
-    , no_gui(false)
-    , running(false)
-    , mtx_ptr(std::make_unique<std::mutex>())
-    , finish_threads(0)
-    , _simulation_parameters(nullptr)
-    , persistent_gui(nullptr)
-    , vkch_ctxt(nullptr)
-    , aux_ctxt(nullptr)
-    , volume_buffers(nullptr)
-  {}
-
   bool no_gui;
   bool running;
+  bool session_open;
   std::unique_ptr<std::mutex> mtx_ptr;
   std::thread compute_thread;
   volatile int finish_threads;
 
   std::shared_ptr<SimulationParameters const> _simulation_parameters;
+  std::vector<DiagnosticsSample> _diagnostics;
+  std::vector<bool> _members_stopping;
+  std::shared_ptr<Checkpoint> _resume_checkpoint;
+  vkch::PipelineCacheStatistics _pipeline_cache_statistics;
+  double _host_seconds;
+  uintmax_t _host_steps;
 
   std::shared_ptr<PersistentGUI> persistent_gui;
 
@@ -5,15 +5,79 @@
 #include <cstring>
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "constants.h"
 #include "Medium.hpp"
+#include "MediumSchedule.hpp"
 #include "SeedCrystal.hpp"
+#include "ReadbackRegion.hpp"
 
 #ifndef M_PI
 #define M_PI 3.141592653589793238462643383279502884197169399375
 #endif // M_PI
 
+// Implementation of the solver step, all produce identical results.
+enum class SolverKernel
+{
+  // One invocation per voxel, all neighbours loaded from global memory.
+  DIRECT = 0,
+  // Tiles staged with a one voxel halo in workgroup shared memory.
+  TILED = 1,
+  // Several steps advanced per dispatch on tiles in shared memory.
+  TEMPORAL_BLOCKED = 2,
+  // Only tiles that changed, or neighbour a tile that changed, in the
+  // previous step are updated.
+  ACTIVE_TILES = 3
+};
+
+// Symmetry of the initial fields about the centre voxel that is preserved by
+// the solver, only the fundamental wedge of the domain is stored and updated.
+enum class SymmetryMode
+{
+  // The whole domain.
+  NONE = 0,
+  // Rotations by sixths of a turn and mirrors in the hexagonal plane, 1/12.
+  D6 = 1,
+  // As D6 plus the mirror in z about the seed plane, 1/24.
+  D6H = 2
+};
+
+// How the solver receives the medium.
+enum class MediumMode
+{
+  // Specialisation constants of the solver pipeline, folded into the kernel
+  // by the driver. A scheduled change rebuilds the pipeline, and takes effect
+  // from the next submission.
+  SPECIALISED = 0,
+  // Push constants of every solver dispatch, read by the kernel. A scheduled
+  // change takes effect from the next dispatch without rebuilding anything.
+  PUSH_CONSTANTS = 1
+};
+
+// What the simulation does when a measurement is due while every snapshot
+// of the measurement ring waits for, or is in, measurement.
+enum class MeasurementBackpressure
+{
+  // Wait for the measurement of the oldest snapshot to finish.
+  BLOCK = 0,
+  // Skip the measurement and carry on.
+  DROP = 1
+};
+
+// How the fields are laid out in GPU memory. Downloads are converted to the
+// planar layout, so measurements and checkpoints see the same fields either
+// way.
+enum class FieldLayout
+{
+  // One plane of floats per field: occupancy, diffusive mass, boundary mass.
+  PLANAR = 0,
+  // The diffusive and boundary mass of each voxel interleaved, followed by
+  // occupancy packed one bit per voxel.
+  PACKED = 1
+};
+
 struct SimulationParameters
 {
 public:
@@ -21,6 +85,22 @@ public:
     : _x_size(DEFAULT_XSIZE)
     , _y_size(DEFAULT_YSIZE)
     , _z_size(DEFAULT_ZSIZE)
+    , _steps_per_submit(DEFAULT_STEPS_PER_SUBMIT)
+    , _measurement_interval(DEFAULT_MEASUREMENT_INTERVAL)
+    , _diagnostics_interval(DEFAULT_DIAGNOSTICS_INTERVAL)
+    , _solver_kernel(DEFAULT_SOLVER_KERNEL)
+    , _temporal_blocking_steps(DEFAULT_TEMPORAL_BLOCKING_STEPS)
+    , _symmetry(DEFAULT_SYMMETRY)
+    , _adaptive_growth(DEFAULT_ADAPTIVE_GROWTH)
+    , _growth_margin(DEFAULT_GROWTH_MARGIN)
+    , _growth_depletion_tolerance(DEFAULT_GROWTH_DEPLETION_TOLERANCE)
+    , _checkpoint_interval(DEFAULT_CHECKPOINT_INTERVAL)
+    , _fork_step(DEFAULT_FORK_STEP)
+    , _medium_mode(DEFAULT_MEDIUM_MODE)
+    , _measurement_depth(DEFAULT_MEASUREMENT_DEPTH)
+    , _measurement_backpressure(DEFAULT_MEASUREMENT_BACKPRESSURE)
+    , _field_layout(DEFAULT_FIELD_LAYOUT)
+    , _record_every_submission(DEFAULT_RECORD_EVERY_SUBMISSION)
   {
     recalculate_radii();
   }
@@ -31,6 +111,22 @@ public:
     , _x_size(DEFAULT_XSIZE)
     , _y_size(DEFAULT_YSIZE)
     , _z_size(DEFAULT_ZSIZE)
+    , _steps_per_submit(DEFAULT_STEPS_PER_SUBMIT)
+    , _measurement_interval(DEFAULT_MEASUREMENT_INTERVAL)
+    , _diagnostics_interval(DEFAULT_DIAGNOSTICS_INTERVAL)
+    , _solver_kernel(DEFAULT_SOLVER_KERNEL)
+    , _temporal_blocking_steps(DEFAULT_TEMPORAL_BLOCKING_STEPS)
+    , _symmetry(DEFAULT_SYMMETRY)
+    , _adaptive_growth(DEFAULT_ADAPTIVE_GROWTH)
+    , _growth_margin(DEFAULT_GROWTH_MARGIN)
+    , _growth_depletion_tolerance(DEFAULT_GROWTH_DEPLETION_TOLERANCE)
+    , _checkpoint_interval(DEFAULT_CHECKPOINT_INTERVAL)
+    , _fork_step(DEFAULT_FORK_STEP)
+    , _medium_mode(DEFAULT_MEDIUM_MODE)
+    , _measurement_depth(DEFAULT_MEASUREMENT_DEPTH)
+    , _measurement_backpressure(DEFAULT_MEASUREMENT_BACKPRESSURE)
+    , _field_layout(DEFAULT_FIELD_LAYOUT)
+    , _record_every_submission(DEFAULT_RECORD_EVERY_SUBMISSION)
   {
     recalculate_radii();
   }
@@ -55,6 +151,16 @@ public:
     return _seed;
   }
 
+  inline void setReadback(ReadbackRegion const &ireadback)
+  {
+    _readback = ireadback;
+  }
+
+  inline ReadbackRegion const &readback() const
+  {
+    return _readback;
+  }
+
   inline void setVoxelXCount(int ix_size)
   {
     _x_size = ix_size;
@@ -98,6 +204,294 @@ public:
     return _radiusZ;
   }
 
+  // Number of solver steps recorded into each command buffer submission,
+  // the host only synchronises with the device once per submission. Rounded
+  // up to a whole number of dispatches of the solver kernel.
+  inline void setStepsPerSubmit(int isteps_per_submit)
+  {
+    _steps_per_submit = (isteps_per_submit < 1) ? 1 : isteps_per_submit;
+  }
+
+  inline int stepsPerSubmit() const
+  {
+    return _steps_per_submit;
+  }
+
+  // Fields are only downloaded, and measurements only taken, on submissions
+  // that complete a step which is a multiple of this interval.
+  inline void setMeasurementInterval(int imeasurement_interval)
+  {
+    _measurement_interval =
+      (imeasurement_interval < 1) ? 1 : imeasurement_interval;
+  }
+
+  inline int measurementInterval() const
+  {
+    return _measurement_interval;
+  }
+
+  // Snapshots of the fields downloaded for measurement, measured on a thread
+  // of their own while the simulation continues. Two are downloaded at once
+  // at most, one per submission in flight, the others wait for or are in
+  // measurement.
+  inline void setMeasurementDepth(int imeasurement_depth)
+  {
+    _measurement_depth = (imeasurement_depth < 2) ? 2 : imeasurement_depth;
+  }
+
+  inline int measurementDepth() const
+  {
+    return _measurement_depth;
+  }
+
+  inline void setMeasurementBackpressure(
+    MeasurementBackpressure imeasurement_backpressure)
+  {
+    _measurement_backpressure = imeasurement_backpressure;
+  }
+
+  inline MeasurementBackpressure measurementBackpressure() const
+  {
+    return _measurement_backpressure;
+  }
+
+  // Scalar diagnostics are reduced on the GPU after every step that is a
+  // multiple of this interval, zero disables them.
+  inline void setDiagnosticsInterval(int idiagnostics_interval)
+  {
+    _diagnostics_interval =
+      (idiagnostics_interval < 0) ? 0 : idiagnostics_interval;
+  }
+
+  inline int diagnosticsInterval() const
+  {
+    return _diagnostics_interval;
+  }
+
+  inline void setSolverKernel(SolverKernel isolver_kernel)
+  {
+    _solver_kernel = isolver_kernel;
+  }
+
+  inline SolverKernel solverKernel() const
+  {
+    return _solver_kernel;
+  }
+
+  // Only the direct solver kernel stores the packed layout, without a
+  // symmetry, an ensemble, a fork or pushed media. Any other simulation
+  // keeps the planar layout.
+  inline void setFieldLayout(FieldLayout ifield_layout)
+  {
+    _field_layout = ifield_layout;
+  }
+
+  inline FieldLayout fieldLayout() const
+  {
+    return _field_layout;
+  }
+
+  // Record the solver command buffers again before every submission instead
+  // of resubmitting them while nothing they depend on changes. Only useful to
+  // measure what recording them once saves.
+  inline void setRecordEverySubmission(bool irecord_every_submission)
+  {
+    _record_every_submission = irecord_every_submission;
+  }
+
+  inline bool recordEverySubmission() const
+  {
+    return _record_every_submission;
+  }
+
+  // Steps advanced per dispatch by the temporally blocked solver kernel,
+  // from 1 to SOLVER_TEMPORAL_MAX_STEPS.
+  inline void setTemporalBlockingSteps(int itemporal_blocking_steps)
+  {
+    _temporal_blocking_steps =
+      (itemporal_blocking_steps < 1) ? 1 :
+        ((itemporal_blocking_steps > SOLVER_TEMPORAL_MAX_STEPS) ?
+          SOLVER_TEMPORAL_MAX_STEPS : itemporal_blocking_steps);
+  }
+
+  inline int temporalBlockingSteps() const
+  {
+    return _temporal_blocking_steps;
+  }
+
+  inline int stepsPerDispatch() const
+  {
+    return ((_symmetry == SymmetryMode::NONE) &&
+      (_solver_kernel == SolverKernel::TEMPORAL_BLOCKED)) ?
+        _temporal_blocking_steps : 1;
+  }
+
+  // With a symmetry other than NONE the solver kernel setting is ignored,
+  // the fundamental wedge is updated by its own kernel. The medium is always
+  // isotropic, the seed crystal is only symmetric under D6H for an odd
+  // thickness.
+  inline void setSymmetry(SymmetryMode isymmetry)
+  {
+    _symmetry = isymmetry;
+  }
+
+  inline SymmetryMode symmetry() const
+  {
+    return _symmetry;
+  }
+
+  // Start from a small grid around the seed and grow it towards the voxel
+  // counts whenever the depletion zone comes within the growth margin of the
+  // edge of the domain. Measurements always see the full voxel counts.
+  inline void setAdaptiveGrowth(bool iadaptive_growth)
+  {
+    _adaptive_growth = iadaptive_growth;
+  }
+
+  inline bool adaptiveGrowth() const
+  {
+    return _adaptive_growth;
+  }
+
+  inline void setGrowthMargin(int igrowth_margin)
+  {
+    _growth_margin = (igrowth_margin < 1) ? 1 : igrowth_margin;
+  }
+
+  inline int growthMargin() const
+  {
+    return _growth_margin;
+  }
+
+  // Relative difference of the diffusive mass from rho beyond which a voxel
+  // is in the depletion zone.
+  inline void setGrowthDepletionTolerance(double igrowth_depletion_tolerance)
+  {
+    _growth_depletion_tolerance = igrowth_depletion_tolerance;
+  }
+
+  inline double growthDepletionTolerance() const
+  {
+    return _growth_depletion_tolerance;
+  }
+
+  // File the compute pipeline cache is loaded from before the simulation
+  // and saved to after it, none if empty. It is only used by the same device
+  // and driver version that wrote it.
+  inline void setPipelineCacheFile(std::string const &ipipeline_cache_file)
+  {
+    _pipeline_cache_file = ipipeline_cache_file;
+  }
+
+  inline std::string const &pipelineCacheFile() const
+  {
+    return _pipeline_cache_file;
+  }
+
+  // File checkpoints are written to, replacing the previous one, none if
+  // empty. Simulation::resume() continues a simulation from it.
+  inline void setCheckpointFile(std::string const &icheckpoint_file)
+  {
+    _checkpoint_file = icheckpoint_file;
+  }
+
+  inline std::string const &checkpointFile() const
+  {
+    return _checkpoint_file;
+  }
+
+  // Checkpoints are written after submissions that complete a step which is
+  // a multiple of this interval, zero disables them.
+  inline void setCheckpointInterval(int icheckpoint_interval)
+  {
+    _checkpoint_interval =
+      (icheckpoint_interval < 0) ? 0 : icheckpoint_interval;
+  }
+
+  inline int checkpointInterval() const
+  {
+    return _checkpoint_interval;
+  }
+
+  // Media of an ensemble of crystals on the same grid, advanced together by
+  // each dispatch. The medium setting is ignored when this is not empty.
+  // Ensembles use the direct solver kernel without symmetry, adaptive growth
+  // or diagnostics.
+  inline void setEnsembleMedia(std::vector<Medium> const &iensemble_media)
+  {
+    _ensemble_media = iensemble_media;
+  }
+
+  inline std::vector<Medium> const &ensembleMedia() const
+  {
+    return _ensemble_media;
+  }
+
+  inline int ensembleSize() const
+  {
+    return static_cast<int>(_ensemble_media.size());
+  }
+
+  // Once the simulation reaches this step, at the end of a submission, its
+  // fields are copied on the device into one branch per fork medium. The
+  // branches continue as an ensemble of those media. Zero, or no fork
+  // media, never forks. Forked simulations run without symmetry or
+  // adaptive growth, and cannot be ensembles before the fork.
+  inline void setForkStep(int ifork_step)
+  {
+    _fork_step = (ifork_step < 0) ? 0 : ifork_step;
+  }
+
+  inline int forkStep() const
+  {
+    return _fork_step;
+  }
+
+  inline void setForkMedia(std::vector<Medium> const &ifork_media)
+  {
+    _fork_media = ifork_media;
+  }
+
+  inline std::vector<Medium> const &forkMedia() const
+  {
+    return _fork_media;
+  }
+
+  inline bool forks() const
+  {
+    return (_fork_step > 0) && !_fork_media.empty();
+  }
+
+  // Pushed media run on the direct solver kernel without symmetry, and do
+  // not apply to ensembles, whose members read their media from records.
+  inline void setMediumMode(MediumMode imedium_mode)
+  {
+    _medium_mode = imedium_mode;
+  }
+
+  inline MediumMode mediumMode() const
+  {
+    return _medium_mode;
+  }
+
+  // Changes of the medium during the simulation, none if empty. Ensembles,
+  // and the branches of a fork, keep the media of their members.
+  inline void setMediumSchedule(MediumSchedule const &imedium_schedule)
+  {
+    _medium_schedule = imedium_schedule;
+  }
+
+  inline MediumSchedule const &mediumSchedule() const
+  {
+    return _medium_schedule;
+  }
+
+  // The medium the solver applies at the step.
+  inline Medium const &mediumAt(uintmax_t step) const
+  {
+    return _medium_schedule.at(step, _medium);
+  }
+
 private:
 
   inline void recalculate_radii()
@@ -113,8 +507,31 @@ private:
 
   Medium _medium;
   SeedCrystal _seed;
+  ReadbackRegion _readback;
 
   // Voxel sizes
   int _x_size, _y_size, _z_size;
   int _radiusT, _radiusZ;
+
+  int _steps_per_submit;
+  int _measurement_interval;
+  int _diagnostics_interval;
+  SolverKernel _solver_kernel;
+  int _temporal_blocking_steps;
+  SymmetryMode _symmetry;
+  bool _adaptive_growth;
+  int _growth_margin;
+  double _growth_depletion_tolerance;
+  std::string _pipeline_cache_file;
+  std::string _checkpoint_file;
+  int _checkpoint_interval;
+  std::vector<Medium> _ensemble_media;
+  int _fork_step;
+  std::vector<Medium> _fork_media;
+  MediumMode _medium_mode;
+  MediumSchedule _medium_schedule;
+  int _measurement_depth;
+  MeasurementBackpressure _measurement_backpressure;
+  FieldLayout _field_layout;
+  bool _record_every_submission;
 };
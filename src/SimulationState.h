@@ -1,5 +1,18 @@
 #pragma once
 
+#include <array>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+  (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+// Batch sampling is compiled for AVX2 as well, and used if the CPU has it.
+#define SIMULATION_STATE_AVX2 __attribute__((target("avx2")))
+#endif
+
 #include "constants.h"
 #include "SimulationParameters.h"
 
@@ -7,10 +20,115 @@ class SimulationState
 {
 public:
   inline SimulationState(float const *iall_simulation_fields,
-    SimulationParameters const &isimulation_parameters)
+    SimulationParameters const &isimulation_parameters,
+    int imember = 0,
+    bool ibranch = false)
     : _fields_ptr(iall_simulation_fields)
     , _simulation_parameters(isimulation_parameters)
-  {}
+    , _member(imember)
+    , _branch(ibranch)
+  {
+    // Snapshots may only hold some fields over a box of voxels, see
+    // ReadbackRegion for the compact layout.
+    const int counts[3] = {
+      _simulation_parameters.voxelXCount(),
+      _simulation_parameters.voxelYCount(),
+      _simulation_parameters.voxelZCount()
+    };
+    _simulation_parameters.readback().resolve(counts, _begin, _end);
+
+    const intmax_t region_size =
+      intmax_t(_end[0] - _begin[0]) *
+      intmax_t(_end[1] - _begin[1]) *
+      intmax_t(_end[2] - _begin[2]);
+    int present = 0;
+    for (int m = 0; m < SOLVER_FIELD_COUNT; m++)
+    {
+      _field_offset[m] = -1;
+      if (_simulation_parameters.readback().field(m))
+      {
+        _field_offset[m] = present * region_size;
+        present++;
+      }
+    } // m
+  }
+
+  // Ensemble member, or branch of a forked simulation, of this snapshot, 0
+  // otherwise.
+  inline int member() const
+  {
+    return _member;
+  }
+
+  // Whether this snapshot is of a branch of a forked simulation, taken after
+  // the fork.
+  inline bool branch() const
+  {
+    return _branch;
+  }
+
+  // Medium of this snapshot's crystal.
+  inline Medium const &medium() const
+  {
+    if (_simulation_parameters.ensembleSize() > 0)
+    {
+      return _simulation_parameters.ensembleMedia()[_member];
+    }
+    return (_branch) ?
+      _simulation_parameters.forkMedia()[_member] :
+      _simulation_parameters.medium();
+  }
+
+  // The fields of this snapshot in the compact layout of the readback
+  // region, valid while the snapshot is.
+  inline float const *fields() const
+  {
+    return _fields_ptr;
+  }
+
+  inline uintmax_t element_count() const
+  {
+    const int counts[3] = {
+      _simulation_parameters.voxelXCount(),
+      _simulation_parameters.voxelYCount(),
+      _simulation_parameters.voxelZCount()
+    };
+    return _simulation_parameters.readback().element_count(counts);
+  }
+
+  // Whether the field is present in this snapshot.
+  inline bool has_field(int m) const
+  {
+    return (_field_offset[m] >= 0);
+  }
+
+  // A compact field of this snapshot, laid out z-major over its box, valid
+  // while the snapshot is. nullptr if the field is not present.
+  inline float const *field_data(int m) const
+  {
+    return (has_field(m)) ? (_fields_ptr + _field_offset[m]) : nullptr;
+  }
+
+  // First voxel, and voxel count, of the box held in this snapshot in each
+  // dimension.
+  inline int region_begin(int d) const
+  {
+    return _begin[d];
+  }
+
+  inline int region_count(int d) const
+  {
+    return _end[d] - _begin[d];
+  }
+
+  // Whether the voxel is inside the box held in this snapshot.
+  inline bool in_region(int64_t ix, int64_t iy, int64_t iz) const
+  {
+    return
+      (ix >= _begin[0]) && (ix < _end[0]) &&
+      (iy >= _begin[1]) && (iy < _end[1]) &&
+      (iz >= _begin[2]) && (iz < _end[2]);
+  }
 
   inline float occupancy(float x, float y, float z) const
   {
@@ -33,10 +151,49 @@ public:
     return q_samples[FIELD_BOUNDARY_MASS];
   }
 
+  // Samples count points, their (x, y, z) coordinates interleaved, as the
+  // point lookups above. For each field of the mask, in field order, the
+  // values of all points follow one another in out. Vectorised with AVX2
+  // where the CPU supports it, and spread over threads for large batches.
+  inline void sample_points(float const *points, size_t count,
+    unsigned int field_mask, float *out) const
+  {
+    const size_t hardware_threads = std::thread::hardware_concurrency();
+    size_t thread_count = count / SAMPLE_POINTS_PER_THREAD;
+    thread_count = (thread_count < hardware_threads) ?
+      thread_count : hardware_threads;
+    if (thread_count <= 1)
+    {
+      sample_range(points, count, 0, count, field_mask, out);
+      return;
+    }
+
+    // Whole vectors of points per thread.
+    const size_t chunk = (((count / thread_count) + 7) / 8) * 8;
+    std::vector<std::thread> threads;
+    for (size_t begin = 0; begin < count; begin += chunk)
+    {
+      const size_t end = ((begin + chunk) < count) ? (begin + chunk) : count;
+      threads.emplace_back([=]()
+      {
+        sample_range(points, count, begin, end, field_mask, out);
+      });
+    } // begin
+    for (std::thread &thread : threads)
+    {
+      thread.join();
+    } // thread
+  }
+
 private:
 
-  inline std::array<float, SOLVER_FIELD_COUNT> sample_all(
-    float x, float y, float z) const
+  // Index within each compact field of the voxel a point falls in, through
+  // the cube coordinates of the hexagonal lattice. OUTSIDE_RADIUS beyond the
+  // simulated radius, OUTSIDE_REGION outside the box of this snapshot.
+  static constexpr int64_t OUTSIDE_RADIUS = -1;
+  static constexpr int64_t OUTSIDE_REGION = -2;
+
+  inline int64_t locate(float x, float y, float z) const
   {
     // Construct triple coordinates.
     const float i = (x / sqrt(3.0)) * 2.0;
@@ -49,9 +206,9 @@ private:
     int new_j = round(j);
     int new_h = round(h);
 
-    const float frac_i = abs(new_i - i);
-    const float frac_j = abs(new_j - j);
-    const float frac_h = abs(new_h - h);
+    const float frac_i = std::fabs(new_i - i);
+    const float frac_j = std::fabs(new_j - j);
+    const float frac_h = std::fabs(new_h - h);
 
     // Detect axial distances and reproject.
     if ((frac_i > frac_j) && (frac_i > frac_h))
@@ -79,38 +236,279 @@ private:
       (((bi+bj) >= radiusT) || ((bi) >= radiusT) || ((bj) >= radiusT)) ||
       ((-bk) > radiusZ) || (bk >= radiusZ));
 
-    if (outside_radius_condition)
-    {
-      std::array<float, SOLVER_FIELD_COUNT> samples = {
-        0.f,
-        float(_simulation_parameters.medium().rho()),
-        0.f
-      };
-      return samples;
-    }
+    if (outside_radius_condition) return OUTSIDE_RADIUS;
 
     int64_t di = bi + (x_size / 2);
     int64_t dj = bj + (y_size / 2);
     int64_t dk = bk + (z_size / 2);
 
-    int64_t idx =
-      dk * ((int64_t)y_size) * ((int64_t)x_size) +
-      dj * ((int64_t)x_size) +
-      di;
+    // Not part of this snapshot.
+    if (!in_region(di, dj, dk)) return OUTSIDE_REGION;
+
+    return region_index(di, dj, dk);
+  }
+
+  // Field value at a located point, the quiescent vapour outside the
+  // simulated radius and NaN where the snapshot holds no value.
+  inline float sample_located(int64_t idx, int m) const
+  {
+    if (idx == OUTSIDE_RADIUS)
+    {
+      return (m == FIELD_DIFFUSIVE_MASS) ? float(medium().rho()) : 0.f;
+    }
+    return ((idx >= 0) && has_field(m)) ?
+      _fields_ptr[_field_offset[m] + idx] :
+      std::numeric_limits<float>::quiet_NaN();
+  }
 
-    const intmax_t total_size = x_size*y_size*z_size;
+  inline std::array<float, SOLVER_FIELD_COUNT> sample_all(
+    float x, float y, float z) const
+  {
+    const int64_t idx = locate(x, y, z);
 
     std::array<float, SOLVER_FIELD_COUNT> retvals;
     for (int m = 0; m < SOLVER_FIELD_COUNT; m++)
     {
-      retvals[m] = _fields_ptr[m*total_size + idx];
+      retvals[m] = sample_located(idx, m);
     } // m
 
     return retvals;
   }
 
+  // Samples the points from begin to end of a batch of count points.
+  inline void sample_range(float const *points, size_t count,
+    size_t begin, size_t end, unsigned int field_mask, float *out) const
+  {
+    size_t p = begin;
+#if defined(SIMULATION_STATE_AVX2)
+    // Indices within the snapshot box are gathered as 32-bit integers.
+    const int64_t region_elements =
+      int64_t(region_count(0)) * int64_t(region_count(1)) *
+      int64_t(region_count(2));
+    if (__builtin_cpu_supports("avx2") &&
+      (region_elements <= std::numeric_limits<int32_t>::max()))
+    {
+      p = sample_range_avx2(points, count, begin, end, field_mask, out);
+    }
+#endif // defined(SIMULATION_STATE_AVX2)
+    for (; p < end; p++)
+    {
+      const int64_t idx =
+        locate(points[3*p], points[3*p + 1], points[3*p + 2]);
+      int o = 0;
+      for (int m = 0; m < SOLVER_FIELD_COUNT; m++)
+      {
+        if (!((field_mask >> m) & 1)) continue;
+
+        out[o*count + p] = sample_located(idx, m);
+        o++;
+      } // m
+    } // p
+  }
+
+#if defined(SIMULATION_STATE_AVX2)
+  // Rounds halfway cases away from zero, as round() does.
+  SIMULATION_STATE_AVX2
+  static inline __m256 round_avx2(__m256 v)
+  {
+    const __m256 t = _mm256_round_ps(v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    const __m256 d = _mm256_sub_ps(v, t);
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 up =
+      _mm256_and_ps(_mm256_cmp_ps(d, _mm256_set1_ps(0.5f), _CMP_GE_OQ), one);
+    const __m256 down =
+      _mm256_and_ps(_mm256_cmp_ps(d, _mm256_set1_ps(-0.5f), _CMP_LE_OQ), one);
+    return _mm256_add_ps(t, _mm256_sub_ps(up, down));
+  }
+
+  // float((double(x) / sqrt(3.0)) * 2.0) and float(double(y) - 0.5*i),
+  // computed in double as locate() does.
+  SIMULATION_STATE_AVX2
+  static inline void triple_avx2(__m256 x, __m256 y, __m256 &i, __m256 &j)
+  {
+    const __m256d sqrt3 = _mm256_set1_pd(sqrt(3.0));
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+    __m128 i_halves[2];
+    __m128 j_halves[2];
+    for (int q = 0; q < 2; q++)
+    {
+      const __m256d xd = _mm256_cvtps_pd(
+        (q) ? _mm256_extractf128_ps(x, 1) : _mm256_castps256_ps128(x));
+      const __m256d yd = _mm256_cvtps_pd(
+        (q) ? _mm256_extractf128_ps(y, 1) : _mm256_castps256_ps128(y));
+      i_halves[q] = _mm256_cvtpd_ps(
+        _mm256_mul_pd(_mm256_div_pd(xd, sqrt3), two));
+      j_halves[q] = _mm256_cvtpd_ps(
+        _mm256_sub_pd(yd,
+          _mm256_mul_pd(half, _mm256_cvtps_pd(i_halves[q]))));
+    } // q
+    i = _mm256_insertf128_ps(
+      _mm256_castps128_ps256(i_halves[0]), i_halves[1], 1);
+    j = _mm256_insertf128_ps(
+      _mm256_castps128_ps256(j_halves[0]), j_halves[1], 1);
+  }
+
+  // locate() and sample_located() for eight points at a time, returns the
+  // first point left for the scalar loop.
+  SIMULATION_STATE_AVX2
+  size_t sample_range_avx2(float const *points, size_t count,
+    size_t begin, size_t end, unsigned int field_mask, float *out) const
+  {
+    const __m256 sign = _mm256_set1_ps(-0.f);
+    const __m256i lanes3 = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+
+    const int32_t radiusT = _simulation_parameters.radiusT();
+    const int32_t radiusZ = _simulation_parameters.radiusZ();
+    const __m256i radiusT_neg = _mm256_set1_epi32(-radiusT);
+    const __m256i radiusT_less1 = _mm256_set1_epi32(radiusT - 1);
+    const __m256i radiusZ_neg = _mm256_set1_epi32(-radiusZ);
+    const __m256i radiusZ_less1 = _mm256_set1_epi32(radiusZ - 1);
+    const __m256i centre_x =
+      _mm256_set1_epi32(_simulation_parameters.voxelXCount() / 2);
+    const __m256i centre_y =
+      _mm256_set1_epi32(_simulation_parameters.voxelYCount() / 2);
+    const __m256i centre_z =
+      _mm256_set1_epi32(_simulation_parameters.voxelZCount() / 2);
+    const __m256i begin_x = _mm256_set1_epi32(_begin[0]);
+    const __m256i begin_y = _mm256_set1_epi32(_begin[1]);
+    const __m256i begin_z = _mm256_set1_epi32(_begin[2]);
+    const __m256i begin_less1 = _mm256_set1_epi32(-1);
+    const __m256i count_x = _mm256_set1_epi32(region_count(0));
+    const __m256i count_y = _mm256_set1_epi32(region_count(1));
+    const __m256i count_z = _mm256_set1_epi32(region_count(2));
+
+    const __m256 nan =
+      _mm256_set1_ps(std::numeric_limits<float>::quiet_NaN());
+
+    size_t p = begin;
+    for (; (p + 8) <= end; p += 8)
+    {
+      float const *point = points + 3*p;
+      const __m256 x = _mm256_i32gather_ps(point, lanes3, 4);
+      const __m256 y = _mm256_i32gather_ps(point + 1, lanes3, 4);
+      const __m256 z = _mm256_i32gather_ps(point + 2, lanes3, 4);
+
+      // Construct triple coordinates.
+      __m256 i, j;
+      triple_avx2(x, y, i, j);
+      const __m256 h = _mm256_xor_ps(_mm256_add_ps(i, j), sign);
+
+      // Carry out rounding on triple coordinates
+      const __m256 round_i = round_avx2(i);
+      const __m256 round_j = round_avx2(j);
+      const __m256 round_h = round_avx2(h);
+      const __m256i new_i = _mm256_cvttps_epi32(round_i);
+      const __m256i new_j = _mm256_cvttps_epi32(round_j);
+      const __m256i new_h = _mm256_cvttps_epi32(round_h);
+
+      const __m256 frac_i = _mm256_andnot_ps(sign, _mm256_sub_ps(round_i, i));
+      const __m256 frac_j = _mm256_andnot_ps(sign, _mm256_sub_ps(round_j, j));
+      const __m256 frac_h = _mm256_andnot_ps(sign, _mm256_sub_ps(round_h, h));
+
+      // Detect axial distances and reproject, only i and j are needed.
+      const __m256i reproject_i = _mm256_castps_si256(_mm256_and_ps(
+        _mm256_cmp_ps(frac_i, frac_j, _CMP_GT_OQ),
+        _mm256_cmp_ps(frac_i, frac_h, _CMP_GT_OQ)));
+      const __m256i reproject_j = _mm256_andnot_si256(reproject_i,
+        _mm256_castps_si256(_mm256_cmp_ps(frac_j, frac_h, _CMP_GT_OQ)));
+      const __m256i bi = _mm256_blendv_epi8(new_i,
+        _mm256_sub_epi32(_mm256_setzero_si256(),
+          _mm256_add_epi32(new_j, new_h)),
+        reproject_i);
+      const __m256i bj = _mm256_blendv_epi8(new_j,
+        _mm256_sub_epi32(_mm256_setzero_si256(),
+          _mm256_add_epi32(new_i, new_h)),
+        reproject_j);
+      const __m256i bk = _mm256_cvttps_epi32(round_avx2(z));
+
+      const __m256i bij = _mm256_add_epi32(bi, bj);
+      __m256i outside_radius = _mm256_or_si256(
+        _mm256_or_si256(
+          _mm256_cmpgt_epi32(bij, radiusT_less1),
+          _mm256_cmpgt_epi32(radiusT_neg, bij)),
+        _mm256_or_si256(
+          _mm256_cmpgt_epi32(bi, radiusT_less1),
+          _mm256_cmpgt_epi32(radiusT_neg, bi)));
+      outside_radius = _mm256_or_si256(outside_radius,
+        _mm256_or_si256(
+          _mm256_cmpgt_epi32(bj, radiusT_less1),
+          _mm256_cmpgt_epi32(radiusT_neg, bj)));
+      outside_radius = _mm256_or_si256(outside_radius,
+        _mm256_or_si256(
+          _mm256_cmpgt_epi32(bk, radiusZ_less1),
+          _mm256_cmpgt_epi32(radiusZ_neg, bk)));
+
+      // Offsets within the snapshot box.
+      const __m256i rx =
+        _mm256_sub_epi32(_mm256_add_epi32(bi, centre_x), begin_x);
+      const __m256i ry =
+        _mm256_sub_epi32(_mm256_add_epi32(bj, centre_y), begin_y);
+      const __m256i rz =
+        _mm256_sub_epi32(_mm256_add_epi32(bk, centre_z), begin_z);
+      const __m256i in_region = _mm256_andnot_si256(outside_radius,
+        _mm256_and_si256(
+          _mm256_and_si256(
+            _mm256_and_si256(
+              _mm256_cmpgt_epi32(rx, begin_less1),
+              _mm256_cmpgt_epi32(count_x, rx)),
+            _mm256_and_si256(
+              _mm256_cmpgt_epi32(ry, begin_less1),
+              _mm256_cmpgt_epi32(count_y, ry))),
+          _mm256_and_si256(
+            _mm256_cmpgt_epi32(rz, begin_less1),
+            _mm256_cmpgt_epi32(count_z, rz))));
+      const __m256i idx = _mm256_and_si256(in_region,
+        _mm256_add_epi32(
+          _mm256_mullo_epi32(
+            _mm256_add_epi32(_mm256_mullo_epi32(rz, count_y), ry), count_x),
+          rx));
+
+      int o = 0;
+      for (int m = 0; m < SOLVER_FIELD_COUNT; m++)
+      {
+        if (!((field_mask >> m) & 1)) continue;
+
+        __m256 values = nan;
+        if (has_field(m))
+        {
+          values = _mm256_mask_i32gather_ps(nan,
+            _fields_ptr + _field_offset[m], idx,
+            _mm256_castsi256_ps(in_region), 4);
+        }
+        values = _mm256_blendv_ps(values,
+          _mm256_set1_ps(
+            (m == FIELD_DIFFUSIVE_MASS) ? float(medium().rho()) : 0.f),
+          _mm256_castsi256_ps(outside_radius));
+        _mm256_storeu_ps(out + o*count + p, values);
+        o++;
+      } // m
+    } // p
+
+    return p;
+  }
+#endif // defined(SIMULATION_STATE_AVX2)
+
+  // Index within each compact field of a voxel inside the snapshot box.
+  inline int64_t region_index(int64_t ix, int64_t iy, int64_t iz) const
+  {
+    return
+      ((iz - _begin[2]) * int64_t(_end[1] - _begin[1]) + (iy - _begin[1])) *
+        int64_t(_end[0] - _begin[0]) +
+      (ix - _begin[0]);
+  }
+
+  // Occupancy of any voxel, voxels outside the snapshot box are unoccupied.
+  inline float occupancy_at(int64_t ix, int64_t iy, int64_t iz) const
+  {
+    if (!in_region(ix, iy, iz)) return 0.f;
+
+    return _fields_ptr[_field_offset[FIELD_OCCUPANCY] +
+      region_index(ix, iy, iz)];
+  }
+
   inline void writeout_stl_pass(
-    FILE *FP, float const *occupancy, int64_t *output_counter)
+    FILE *FP, int64_t *output_counter)
   {
     const intmax_t x_size = _simulation_parameters.voxelXCount();
     const intmax_t y_size = _simulation_parameters.voxelYCount();
@@ -118,10 +516,17 @@ private:
     const intmax_t radiusT = _simulation_parameters.radiusT();
     const intmax_t radiusZ = _simulation_parameters.radiusZ();
 
+    const int64_t iz_begin = (_begin[2] > 1) ? _begin[2] : 1;
+    const int64_t iy_begin = (_begin[1] > 1) ? _begin[1] : 1;
+    const int64_t ix_begin = (_begin[0] > 1) ? _begin[0] : 1;
+    const int64_t iz_end = (_end[2] < (z_size - 1)) ? _end[2] : (z_size - 1);
+    const int64_t iy_end = (_end[1] < (y_size - 1)) ? _end[1] : (y_size - 1);
+    const int64_t ix_end = (_end[0] < (x_size - 1)) ? _end[0] : (x_size - 1);
+
     int64_t counter = 0;
-    for (int64_t iz = 1; iz < (z_size - 1); iz++)
-      for (int64_t iy = 1; iy < (y_size - 1); iy++)
-        for (int64_t ix = 1; ix < (x_size - 1); ix++)
+    for (int64_t iz = iz_begin; iz < iz_end; iz++)
+      for (int64_t iy = iy_begin; iy < iy_end; iy++)
+        for (int64_t ix = ix_begin; ix < ix_end; ix++)
         {
           int64_t bk = iz - (z_size / 2);
           int64_t bj = iy - (y_size / 2);
@@ -145,24 +550,19 @@ private:
   
           if (outside_boundary_condition) continue;
   
-          int64_t idx =
-            iz * ((int64_t)y_size) * ((int64_t)x_size) +
-            iy * ((int64_t)x_size) +
-            ix;
-  
-          if (occupancy[idx])
+          if (occupancy_at(ix, iy, iz))
           {
             for (int a = 0; a < 6; a++)
             {
               bool occ_test = false;
               switch (a)
               {
-                case 0: occ_test = (occupancy[idx + 1] == 0); break;
-                case 1: occ_test = (occupancy[idx + ((int64_t)x_size)] == 0); break;
-                case 2: occ_test = (occupancy[idx + ((int64_t)x_size) - 1] == 0); break;
-                case 3: occ_test = (occupancy[idx - 1] == 0); break;
-                case 4: occ_test = (occupancy[idx - ((int64_t)x_size)] == 0); break;
-                case 5: occ_test = (occupancy[(idx - ((int64_t)x_size)) + 1] == 0); break;
+                case 0: occ_test = (occupancy_at(ix + 1, iy, iz) == 0); break;
+                case 1: occ_test = (occupancy_at(ix, iy + 1, iz) == 0); break;
+                case 2: occ_test = (occupancy_at(ix - 1, iy + 1, iz) == 0); break;
+                case 3: occ_test = (occupancy_at(ix - 1, iy, iz) == 0); break;
+                case 4: occ_test = (occupancy_at(ix, iy - 1, iz) == 0); break;
+                case 5: occ_test = (occupancy_at(ix + 1, iy - 1, iz) == 0); break;
               }
               if (occ_test)
               {
@@ -235,8 +635,8 @@ private:
               bool occ_test = false;
               switch (a)
               {
-                case 0: occ_test = (occupancy[idx - ((int64_t)y_size) * ((int64_t)x_size)] == 0); break;
-                case 1: occ_test = (occupancy[idx + ((int64_t)y_size) * ((int64_t)x_size)] == 0); break;
+                case 0: occ_test = (occupancy_at(ix, iy, iz - 1) == 0); break;
+                case 1: occ_test = (occupancy_at(ix, iy, iz + 1) == 0); break;
               }
               if (occ_test)
               {
@@ -299,7 +699,7 @@ private:
   
             } // a
   
-          } // (occupancy[idx])
+          } // (occupancy_at(ix, iy, iz))
   
         } // ix
   
@@ -311,6 +711,12 @@ private:
 public:
   inline void exportSTL(std::string const &filename)
   {
+    if (!has_field(FIELD_OCCUPANCY))
+    {
+      fprintf(stderr, "cannot export STL, occupancy was not read back\n");
+      return;
+    }
+
     FILE *FP = fopen(filename.c_str(), "wb");
 
     if (FP == nullptr)
@@ -326,12 +732,12 @@ public:
     fwrite(&(header[0]), sizeof(char), 80, FP);
 
     int64_t counter;
-    writeout_stl_pass(nullptr, _fields_ptr, &counter);
+    writeout_stl_pass(nullptr, &counter);
 
     uint32_t int_counter = counter;
     fwrite(&int_counter, sizeof(uint32_t), 1, FP);
 
-    writeout_stl_pass(FP, _fields_ptr, nullptr);
+    writeout_stl_pass(FP, nullptr);
 
     fclose(FP);
 
@@ -340,4 +746,10 @@ public:
 private:
   float const *_fields_ptr;
   SimulationParameters const &_simulation_parameters;
+  int _member;
+  bool _branch;
+
+  int _begin[3];
+  int _end[3];
+  intmax_t _field_offset[SOLVER_FIELD_COUNT];
 };
@@ -6,9 +6,11 @@
 
 #include <memory>
 #include <complex>
+#include <ctime>
 
 #include "VulkanComputeHelper.h"
 #include "SimulationParameters.h"
+#include "SymmetryWedge.hpp"
 #include "Simulation.hpp"
 
 namespace vkch = vkComputeHelper;
@@ -23,50 +25,501 @@ struct StepSimulation
   std::shared_ptr<vkch::SharedTensor<float> > tensor_B;
 
   std::shared_ptr<vkch::TensorParameterSet> params_step_AB;
+  std::shared_ptr<vkch::TensorParameterSet> params_step_BA;
   std::shared_ptr<vkch::TensorParameterSet> params_render_A;
+  std::shared_ptr<vkch::TensorParameterSet> params_reduce_AB;
+  std::shared_ptr<vkch::TensorParameterSet> params_reduce_BA;
+  std::shared_ptr<vkch::TensorParameterSet> params_active_AB;
+  std::shared_ptr<vkch::TensorParameterSet> params_active_BA;
+  std::shared_ptr<vkch::TensorParameterSet> params_build_active;
+  std::shared_ptr<vkch::TensorParameterSet> params_init_A;
 
   std::shared_ptr<vkch::Program> program_step;
   std::shared_ptr<vkch::Program> program_render;
+  std::shared_ptr<vkch::Program> program_reduce;
+  std::shared_ptr<vkch::Program> program_build_active;
+  // Writes the initial fields on the device. Without it tensor_A is uploaded
+  // from staging instead, e.g. to carry fields over from another grid, or
+  // copied on the device from the fork source into every member.
+  std::shared_ptr<vkch::Program> program_init;
+  std::shared_ptr<vkch::Tensor> tensor_fork_source;
+
+  // Active tile scheduling, shared by both steps: the indirect dispatch
+  // counts followed by the active tile list, and the per-tile changed flags
+  // of the previous and current step.
+  std::shared_ptr<vkch::StorageTensor> tensor_active_dispatch;
+  std::shared_ptr<vkch::StorageTensor> tensor_tile_flags;
+
+  // Shared by both steps, written by the final reduction stage and read back
+  // at the end of each submission that reduced anything.
+  std::shared_ptr<vkch::SharedTensor<uint32_t> > tensor_diagnostics_ring;
+
+  // Ensemble member records of this step, uploaded ahead of its solver
+  // dispatches so members stopped by the host are held from then on.
+  std::shared_ptr<vkch::SharedTensor<float> > tensor_members;
 
   std::shared_ptr<vkch::Schema> schema_upload;
   std::shared_ptr<vkch::Schema> schema_step_00_10;
   std::shared_ptr<vkch::Schema> schema_renders;
+  // The whole result into its own staging memory, for checkpoints and to
+  // carry the fields over to another grid.
   std::shared_ptr<vkch::Schema> schema_download;
+  // The readback region into each slot of the measurement ring, which the
+  // host reads while the solver goes on.
+  std::vector<std::shared_ptr<vkch::Tensor> > measurement_slots;
+  std::vector<std::shared_ptr<vkch::Schema> > schema_measurement_downloads;
+  // With a transfer queue the readback region is first copied on the device
+  // into tensor_readback, released to the transfer family, and downloaded
+  // from there into the slot by a schema of the transfer queue, so the next
+  // submission computes while it is read back. The transfer queue signals a
+  // timeline of its own, shared by both steps.
+  std::shared_ptr<vkch::StorageTensor> tensor_readback;
+  std::shared_ptr<vkch::Schema> schema_readback;
+  std::shared_ptr<vkch::Timeline> transfer_timeline;
+  // The transfer timeline value reached once the last readback of this step
+  // is in its slot, which the next copy into tensor_readback waits for.
+  uint64_t readback_value = 0;
 
   std::shared_ptr<vkch::Schema> last_schema;
 
-  void init_schemas(
+  // Shared by both steps when the device has timeline semaphores. Each
+  // schema then waits for the value of the work it reads rather than for
+  // the schema submitted before it: the render and the download both wait
+  // for the solver dispatches only.
+  std::shared_ptr<vkch::Timeline> timeline;
+
+  // Solver dispatches recorded per submission, ping-ponging between tensor_A
+  // and tensor_B. An odd count leaves the result in tensor_B, an even count
+  // in tensor_A. Each dispatch advances steps_per_dispatch solver steps.
+  unsigned int substeps = 1;
+  unsigned int steps_per_dispatch = 1;
+  // Grids of an ensemble are stacked in z, each dispatch advances them all.
+  unsigned int member_count = 1;
+  uintmax_t first_timestep = 0;
+
+  // Whether the last submission downloaded the whole result to its staging
+  // memory, and the measurement slot it downloaded the readback region to,
+  // negative for none.
+  bool downloaded = false;
+  int measurement_slot = -1;
+
+  std::vector<vkch::ConstantBase> no_push_constants;
+  // The ensemble solver initialises with the same program that steps.
+  std::vector<vkch::ConstantBase> push_constants_step;
+  std::vector<vkch::ConstantBase> push_constants_init;
+
+  // With pushed media, the medium of each solver dispatch of the scheduled
+  // submission, as scheduled at its first step.
+  bool medium_pushed = false;
+
+  // Fields stored in the packed layout of PackedFields.hpp, downloaded whole
+  // and unpacked on the host.
+  bool packed_layout = false;
+  std::vector<std::vector<vkch::ConstantBase> > push_constants_media;
+
+  // What the recorded solver dispatches depend on besides the tensors and
+  // programs fixed for the whole grid: the solver program, the timestep
+  // parity of the first dispatch, the dispatches followed by a reduction and
+  // the pushed medium of each dispatch.
+  struct Recording
+  {
+    vkch::Program const *program_step = nullptr;
+    unsigned int parity = 0;
+    std::vector<unsigned int> reduced_substeps;
+    std::vector<Medium const *> media;
+
+    bool operator==(Recording const &other) const
+    {
+      return (program_step == other.program_step) &&
+        (parity == other.parity) &&
+        (reduced_substeps == other.reduced_substeps) &&
+        (media == other.media);
+    }
+  };
+  Recording scheduled_recording;
+  Recording step_recording;
+  bool recorded = false;
+  vk::raii::DescriptorSet const *render_volume_ptr = nullptr;
+
+  // CPU time of the host thread spent scheduling and submitting this step.
+  double host_seconds = 0.0;
+
+  // Steps reduced to diagnostics by the last scheduled submission, in ring
+  // order.
+  std::vector<uintmax_t> diagnostics_steps;
+  std::vector<vkch::ConstantBase> push_constants_reduce_partial = {
+    vkch::Constant<uint32_t>(0)
+  };
+  std::vector<vkch::ConstantBase> push_constants_reduce_final = {
+    vkch::Constant<uint32_t>(1)
+  };
+  std::vector<std::shared_ptr<vkch::Tensor> > upload_tensors;
+  std::vector<std::shared_ptr<vkch::Tensor> > members_upload_tensors;
+  std::vector<std::shared_ptr<vkch::Tensor> > diagnostics_download_tensors;
+
+  // Half of the tile flags recording changes, by timestep parity.
+  std::vector<vkch::ConstantBase> push_constants_flags_parity[2] = {
+    { vkch::Constant<uint32_t>(0) },
+    { vkch::Constant<uint32_t>(1) }
+  };
+
+  static uintmax_t active_tile_count(
+    const SimulationParameters &simulation_parameters)
+  {
+    return
+      uintmax_t(divide_round_up(
+        simulation_parameters.voxelXCount(), SOLVER_ACTIVE_TILE_X)) *
+      uintmax_t(divide_round_up(
+        simulation_parameters.voxelYCount(), SOLVER_ACTIVE_TILE_Y)) *
+      uintmax_t(divide_round_up(
+        simulation_parameters.voxelZCount(), SOLVER_ACTIVE_TILE_Z));
+  }
+
+  static unsigned int divide_round_up(
+    const int voxel_count, const unsigned int workgroup_size)
+  {
+    return (static_cast<unsigned int>(voxel_count) == 0) ?
+      0 :
+      (((static_cast<unsigned int>(voxel_count) - 1) / workgroup_size) + 1);
+  }
+
+  static std::tuple<unsigned int, unsigned int, unsigned int> workgroup_count(
     const SimulationParameters &simulation_parameters,
-    std::shared_ptr<vkch::Context> &vkch_ctxt)
+    const SolverKernel solver_kernel = SolverKernel::DIRECT)
   {
-    const std::tuple<unsigned int, unsigned int, unsigned int> workgroup(
-      (static_cast<unsigned int>(simulation_parameters.voxelXCount()) == 0) ?
-        0 :
-        (((static_cast<unsigned int>(
-          simulation_parameters.voxelXCount()) - 1) / 64) + 1),
+    if (solver_kernel == SolverKernel::TEMPORAL_BLOCKED)
+    {
+      // Only the interior of each footprint is written back.
+      const unsigned int blocked_steps = static_cast<unsigned int>(
+        simulation_parameters.temporalBlockingSteps());
+      return std::tuple<unsigned int, unsigned int, unsigned int>(
+        divide_round_up(simulation_parameters.voxelXCount(),
+          SOLVER_TEMPORAL_FOOTPRINT_X - 2*blocked_steps),
+        divide_round_up(simulation_parameters.voxelYCount(),
+          SOLVER_TEMPORAL_FOOTPRINT_Y - 2*blocked_steps),
+        divide_round_up(simulation_parameters.voxelZCount(),
+          SOLVER_TEMPORAL_FOOTPRINT_Z - 2*blocked_steps)
+      );
+    }
+
+    if (solver_kernel == SolverKernel::TILED)
+    {
+      return std::tuple<unsigned int, unsigned int, unsigned int>(
+        divide_round_up(simulation_parameters.voxelXCount(), SOLVER_TILE_X),
+        divide_round_up(simulation_parameters.voxelYCount(), SOLVER_TILE_Y),
+        divide_round_up(simulation_parameters.voxelZCount(), SOLVER_TILE_Z)
+      );
+    }
+
+    return std::tuple<unsigned int, unsigned int, unsigned int>(
+      divide_round_up(simulation_parameters.voxelXCount(), SOLVER_DIRECT_X),
       static_cast<unsigned int>(simulation_parameters.voxelYCount()),
       static_cast<unsigned int>(simulation_parameters.voxelZCount())
     );
+  }
 
-    // TODO: Need to move schema creation back here - the steps do not need
-    // recreating now they don't depend on time parameters.
+  // One invocation per stored voxel of the fundamental wedge.
+  static std::tuple<unsigned int, unsigned int, unsigned int>
+    wedge_workgroup_count(const SimulationParameters &simulation_parameters)
+  {
+    const SymmetryWedge wedge(simulation_parameters);
+    return std::tuple<unsigned int, unsigned int, unsigned int>(
+      divide_round_up(wedge.x_count(), SOLVER_DIRECT_X),
+      static_cast<unsigned int>(wedge.y_count()),
+      static_cast<unsigned int>(wedge.z_count())
+    );
+  }
+
+  // One invocation per stored voxel, of the full grid or the wedge.
+  static std::tuple<unsigned int, unsigned int, unsigned int>
+    init_workgroup_count(const SimulationParameters &simulation_parameters)
+  {
+    if (simulation_parameters.symmetry() != SymmetryMode::NONE)
+    {
+      return wedge_workgroup_count(simulation_parameters);
+    }
+    return std::tuple<unsigned int, unsigned int, unsigned int>(
+      divide_round_up(simulation_parameters.voxelXCount(), SOLVER_DIRECT_X),
+      static_cast<unsigned int>(simulation_parameters.voxelYCount()),
+      static_cast<unsigned int>(simulation_parameters.voxelZCount())
+    );
+  }
+
+  // Workgroup counts covering every member of an ensemble.
+  std::tuple<unsigned int, unsigned int, unsigned int> stacked(
+    std::tuple<unsigned int, unsigned int, unsigned int> const &workgroup)
+    const
+  {
+    return std::tuple<unsigned int, unsigned int, unsigned int>(
+      std::get<0>(workgroup),
+      std::get<1>(workgroup),
+      std::get<2>(workgroup) * member_count
+    );
+  }
+
+  // kappa, mu and beta by neighbour configuration, as the pushed solver
+  // kernel reads them.
+  static std::vector<vkch::ConstantBase> medium_push_constants(
+    Medium const &medium)
+  {
+    return std::vector<vkch::ConstantBase>{
+      vkch::Constant<float>(0.f),
+      vkch::Constant<float>(medium.kappa_01()),
+      vkch::Constant<float>(medium.kappa_10()),
+      vkch::Constant<float>(medium.kappa_11()),
+      vkch::Constant<float>(medium.kappa_20()),
+      vkch::Constant<float>(medium.kappa_21()),
+      vkch::Constant<float>(medium.kappa_30()),
+      vkch::Constant<float>(medium.kappa_31()),
+      vkch::Constant<float>(0.f),
+      vkch::Constant<float>(medium.mu_01()),
+      vkch::Constant<float>(medium.mu_10()),
+      vkch::Constant<float>(medium.mu_11()),
+      vkch::Constant<float>(medium.mu_20()),
+      vkch::Constant<float>(medium.mu_21()),
+      vkch::Constant<float>(medium.mu_30()),
+      vkch::Constant<float>(medium.mu_31()),
+      vkch::Constant<float>(0.f),
+      vkch::Constant<float>(medium.beta_01()),
+      vkch::Constant<float>(medium.beta_10()),
+      vkch::Constant<float>(medium.beta_11()),
+      vkch::Constant<float>(medium.beta_20()),
+      vkch::Constant<float>(medium.beta_21()),
+      vkch::Constant<float>(medium.beta_30()),
+      vkch::Constant<float>(medium.beta_31())
+    };
+  }
+
+  std::shared_ptr<vkch::SharedTensor<float> > const &result_tensor() const
+  {
+    return (substeps % 2) ? tensor_B : tensor_A;
+  }
+
+  uintmax_t last_timestep() const
+  {
+    return first_timestep + uintmax_t(substeps) * steps_per_dispatch - 1;
+  }
+
+  // True if the scheduled steps include a multiple of the measurement
+  // interval, so the result has to be downloaded for measurement.
+  bool measurement_due(const uintmax_t measurement_interval) const
+  {
+    return
+      ((last_timestep() / measurement_interval) * measurement_interval) >=
+        first_timestep;
+  }
+
+  // True if the scheduled steps include a multiple of the checkpoint
+  // interval, zero for no checkpoints.
+  bool checkpoint_due(const uintmax_t checkpoint_interval) const
+  {
+    return (checkpoint_interval > 0) && measurement_due(checkpoint_interval);
+  }
+
+  void init_schemas(
+    const SimulationParameters &simulation_parameters,
+    std::shared_ptr<vkch::Context> &vkch_ctxt)
+  {
+    // Recorded by the first schedule(), and again only when it has to be.
     schema_step_00_10 =
       vkch_ctxt->schema();
+    recorded = false;
+    render_volume_ptr = nullptr;
+
+    if (tensor_members != nullptr)
+    {
+      members_upload_tensors = std::vector<std::shared_ptr<vkch::Tensor> >{
+        tensor_members
+      };
+    }
 
     schema_upload =
-      vkch_ctxt->schema()
-        ->add<vkch::UploadTensors>(
-          std::vector<std::shared_ptr<vkch::Tensor> >{
-            tensor_A
-          }
-        )
-        ->make();
+      vkch_ctxt->schema();
+    if (program_init != nullptr)
+    {
+      if (tensor_members != nullptr)
+      {
+        schema_upload
+          ->add<vkch::UploadTensors>(members_upload_tensors)
+          ->add<vkch::PipelineBarrier>(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::AccessFlagBits::eTransferWrite,
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::AccessFlagBits::eShaderRead);
+      }
+      schema_upload->add<vkch::Work>(
+        stacked(init_workgroup_count(simulation_parameters)),
+        push_constants_init,
+        params_init_A,
+        program_init
+      );
+    } else if (tensor_fork_source != nullptr)
+    {
+      std::vector<vk::BufferCopy> fork_regions;
+      for (unsigned int m = 0; m < member_count; m++)
+      {
+        fork_regions.emplace_back(
+          0, m * tensor_fork_source->size(), tensor_fork_source->size());
+      } // m
+      schema_upload->add<vkch::CopyTensor>(
+        tensor_fork_source, tensor_A, fork_regions);
+    } else
+    {
+      upload_tensors = std::vector<std::shared_ptr<vkch::Tensor> >{
+        tensor_A
+      };
+      schema_upload->add<vkch::UploadTensors>(upload_tensors);
+    }
+    if (packed_layout)
+    {
+      // The packed solver only sets the occupancy bits new to its output,
+      // so both tensors begin from the initial fields.
+      schema_upload
+        ->add<vkch::PipelineBarrier>(
+          vk::PipelineStageFlagBits::eComputeShader |
+            vk::PipelineStageFlagBits::eTransfer,
+          vk::AccessFlagBits::eShaderWrite |
+            vk::AccessFlagBits::eTransferWrite,
+          vk::PipelineStageFlagBits::eTransfer,
+          vk::AccessFlagBits::eTransferRead)
+        ->add<vkch::CopyTensor>(tensor_A, tensor_B,
+          std::vector<vk::BufferCopy>{
+            vk::BufferCopy(0, 0, tensor_A->size())
+          });
+    }
+    if (tensor_diagnostics_ring != nullptr)
+    {
+      schema_upload->add<vkch::FillTensor>(tensor_diagnostics_ring);
+    }
+    if (tensor_tile_flags != nullptr)
+    {
+      // Every tile counts as changed before the first step.
+      schema_upload->add<vkch::FillTensor>(
+        tensor_tile_flags, 0, VK_WHOLE_SIZE, 1);
+    }
+    schema_upload->make();
+
+    if (tensor_diagnostics_ring != nullptr)
+    {
+      diagnostics_download_tensors =
+        std::vector<std::shared_ptr<vkch::Tensor> >{
+          tensor_diagnostics_ring
+        };
+    }
+
+    // Only copy back the requested fields and box, compactly. The wedge and
+    // packed fields are copied back whole and the box reconstructed from
+    // them on the host.
+    // A compact readback always has regions, the run does not start with an
+    // empty readback region.
+    const bool compact_readback =
+      (simulation_parameters.symmetry() == SymmetryMode::NONE) &&
+      (!packed_layout) &&
+      !simulation_parameters.readback().is_full(
+        simulation_parameters.voxelXCount(),
+        simulation_parameters.voxelYCount(),
+        simulation_parameters.voxelZCount());
+    std::vector<vk::BufferCopy> download_regions;
+    if (compact_readback)
+    {
+      std::vector<ReadbackRegion::Copy> copies =
+        simulation_parameters.readback().copies(
+          simulation_parameters.voxelXCount(),
+          simulation_parameters.voxelYCount(),
+          simulation_parameters.voxelZCount());
+      // Each member's region follows the previous one's in staging.
+      const uintmax_t member_src_size =
+        uintmax_t(simulation_parameters.voxelXCount()) *
+        uintmax_t(simulation_parameters.voxelYCount()) *
+        uintmax_t(simulation_parameters.voxelZCount()) * SOLVER_FIELD_COUNT;
+      uintmax_t member_dst_size = 0;
+      for (size_t c = 0; c < copies.size(); c++)
+      {
+        member_dst_size += copies[c].element_count;
+      } // c
+      for (unsigned int m = 0; m < member_count; m++)
+      {
+        for (size_t c = 0; c < copies.size(); c++)
+        {
+          download_regions.emplace_back(
+            (m * member_src_size + copies[c].src_element) * sizeof(float),
+            (m * member_dst_size + copies[c].dst_element) * sizeof(float),
+            copies[c].element_count * sizeof(float));
+        } // c
+      } // m
+    }
 
+    schema_measurement_downloads.clear();
+    if (transfer_timeline != nullptr)
+    {
+      const std::vector<std::shared_ptr<vkch::Tensor> > readback_tensors = {
+        tensor_readback
+      };
+      schema_readback =
+        vkch_ctxt->schema()
+          ->add<vkch::PipelineBarrier>(
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::AccessFlagBits::eShaderWrite,
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::AccessFlagBits::eTransferRead)
+          ->add<vkch::CopyTensor>(
+            result_tensor(), tensor_readback,
+            (compact_readback) ?
+              download_regions :
+              std::vector<vk::BufferCopy>{
+                vk::BufferCopy(0, 0, result_tensor()->size())
+              })
+          ->add<vkch::QueueFamilyTransfer>(
+            readback_tensors,
+            vkch_ctxt->computeQueueFamily(),
+            vkch_ctxt->transferQueueFamily(),
+            true,
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::AccessFlagBits::eTransferWrite)
+          ->make();
+      for (size_t slot = 0; slot < measurement_slots.size(); slot++)
+      {
+        schema_measurement_downloads.push_back(
+          vkch_ctxt->transferSchema()
+            ->add<vkch::QueueFamilyTransfer>(
+              readback_tensors,
+              vkch_ctxt->computeQueueFamily(),
+              vkch_ctxt->transferQueueFamily(),
+              false,
+              vk::PipelineStageFlagBits::eTransfer,
+              vk::AccessFlagBits::eTransferRead)
+            ->add<vkch::DownloadTensors>(
+              readback_tensors,
+              std::vector<vk::BufferCopy>(),
+              std::vector<std::shared_ptr<vkch::Tensor> >{
+                measurement_slots[slot]
+              }
+            )
+            ->make());
+      } // slot
+    } else
+    {
+      for (size_t slot = 0; slot < measurement_slots.size(); slot++)
+      {
+        schema_measurement_downloads.push_back(
+          vkch_ctxt->schema()
+            ->add<vkch::DownloadTensors>(
+              std::vector<std::shared_ptr<vkch::Tensor> >{
+                result_tensor()
+              },
+              download_regions,
+              std::vector<std::shared_ptr<vkch::Tensor> >{
+                measurement_slots[slot]
+              }
+            )
+            ->make());
+      } // slot
+    }
     schema_download =
       vkch_ctxt->schema()
         ->add<vkch::DownloadTensors>(
           std::vector<std::shared_ptr<vkch::Tensor> >{
-            tensor_A
+            result_tensor()
           }
         )
         ->make();
@@ -82,78 +535,313 @@ struct StepSimulation
     }
   }
 
+  // Schedules the submission starting at the current timestep. The command
+  // buffers are only recorded again when something they depend on differs
+  // from the previous submission of this step, otherwise they are submitted
+  // as they are.
   void schedule(
     std::shared_ptr<VolumeBuffers> const &volume_buffers,
     const SimulationParameters &simulation_parameters,
     const uintmax_t current_timestep
   )
   {
-    const std::tuple<unsigned int, unsigned int, unsigned int> workgroup(
-      (static_cast<unsigned int>(simulation_parameters.voxelXCount()) == 0) ?
-        0 :
-        (((static_cast<unsigned int>(
-          simulation_parameters.voxelXCount()) - 1) / 64) + 1),
-      static_cast<unsigned int>(simulation_parameters.voxelYCount()),
-      static_cast<unsigned int>(simulation_parameters.voxelZCount())
-    );
+    const double host_begin = thread_cpu_seconds();
+    first_timestep = current_timestep;
 
-    schema_step_00_10
-      ->clear()
-      ->add<vkch::Work>(
-        workgroup,
-        std::vector<vkch::ConstantBase>({}),
-        params_step_AB,
-        program_step
-      )
-      ->make();
+    // Reduce the result of any dispatch that completes a step which is a
+    // multiple of the interval, attributed to its last step.
+    const uintmax_t diagnostics_interval =
+      static_cast<uintmax_t>(simulation_parameters.diagnosticsInterval());
+    diagnostics_steps.clear();
+    scheduled_recording.reduced_substeps.clear();
+    for (unsigned int s = 0; s < substeps; s++)
+    {
+      const uintmax_t dispatch_first_timestep =
+        first_timestep + uintmax_t(s) * steps_per_dispatch;
+      const uintmax_t dispatch_last_timestep =
+        dispatch_first_timestep + steps_per_dispatch - 1;
+      if ((program_reduce != nullptr) && (diagnostics_interval > 0) &&
+        (((dispatch_last_timestep / diagnostics_interval) *
+          diagnostics_interval) >= dispatch_first_timestep))
+      {
+        scheduled_recording.reduced_substeps.push_back(s);
+        diagnostics_steps.push_back(dispatch_last_timestep);
+      }
+    } // s
+
+    // Submissions of a step are two submissions apart, so they usually begin
+    // on the same timestep parity.
+    scheduled_recording.program_step = program_step.get();
+    scheduled_recording.parity = first_timestep % 2;
+    scheduled_recording.media.clear();
+    if (medium_pushed)
+    {
+      for (unsigned int s = 0; s < substeps; s++)
+      {
+        scheduled_recording.media.push_back(
+          &(simulation_parameters.mediumAt(
+            first_timestep + uintmax_t(s) * steps_per_dispatch)));
+      } // s
+    }
+    if (simulation_parameters.recordEverySubmission() ||
+      !(recorded && (scheduled_recording == step_recording)))
+    {
+      record_steps(simulation_parameters);
+      step_recording = scheduled_recording;
+      recorded = true;
+    }
 
     if (!no_gui)
     {
       vk::raii::DescriptorSet const *latest_volume_ptr =
         &(volume_buffers->write_descriptor_set());
-
-      schema_renders
-        ->clear()
-        ->add<vkch::Work>(
-          workgroup,
-          std::vector<vkch::ConstantBase>({}),
-          params_render_A,
-          program_render,
-          latest_volume_ptr
-        )
-        ->make();
+      if (latest_volume_ptr != render_volume_ptr)
+      {
+        schema_renders
+          ->clear()
+          ->add<vkch::Work>(
+            workgroup_count(simulation_parameters),
+            no_push_constants,
+            params_render_A,
+            program_render,
+            latest_volume_ptr
+          )
+          ->make();
+        render_volume_ptr = latest_volume_ptr;
+      }
     } // (!no_gui)
+    host_seconds += thread_cpu_seconds() - host_begin;
   }
 
+  // Records the solver dispatches of a submission, as last scheduled.
+  void record_steps(const SimulationParameters &simulation_parameters)
+  {
+    const std::tuple<unsigned int, unsigned int, unsigned int>
+      solver_workgroup = stacked(
+        (simulation_parameters.symmetry() != SymmetryMode::NONE) ?
+          wedge_workgroup_count(simulation_parameters) :
+          workgroup_count(
+            simulation_parameters, simulation_parameters.solverKernel()));
+
+    // Sized before any dispatch refers to them, until make() records them.
+    if (medium_pushed)
+    {
+      push_constants_media.resize(substeps);
+      for (unsigned int s = 0; s < substeps; s++)
+      {
+        push_constants_media[s] = medium_push_constants(
+          *(scheduled_recording.media[s]));
+      } // s
+    }
+
+    schema_step_00_10->clear();
+    if (tensor_members != nullptr)
+    {
+      schema_step_00_10
+        ->add<vkch::UploadTensors>(members_upload_tensors)
+        ->add<vkch::PipelineBarrier>(
+          vk::PipelineStageFlagBits::eTransfer,
+          vk::AccessFlagBits::eTransferWrite,
+          vk::PipelineStageFlagBits::eComputeShader,
+          vk::AccessFlagBits::eShaderRead);
+    }
+    size_t reduced = 0;
+    for (unsigned int s = 0; s < substeps; s++)
+    {
+      if (s > 0)
+      {
+        // Previous substep output is the input of this one.
+        schema_step_00_10->add<vkch::PipelineBarrier>();
+      }
+      if (program_build_active != nullptr)
+      {
+        // Reset the dispatch counts once the previous step has read them,
+        // then list the active tiles and dispatch one workgroup for each.
+        const uintmax_t active_tiles = active_tile_count(simulation_parameters);
+        std::vector<vkch::ConstantBase> const &flags_parity =
+          push_constants_flags_parity[(scheduled_recording.parity + s) % 2];
+        schema_step_00_10
+          ->add<vkch::PipelineBarrier>(
+            vk::PipelineStageFlagBits::eDrawIndirect |
+              vk::PipelineStageFlagBits::eComputeShader,
+            vk::AccessFlagBits::eShaderWrite,
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::AccessFlagBits::eTransferWrite)
+          ->add<vkch::FillTensor>(tensor_active_dispatch,
+            0, sizeof(uint32_t), 0)
+          ->add<vkch::FillTensor>(tensor_active_dispatch,
+            sizeof(uint32_t), 2 * sizeof(uint32_t), 1)
+          ->add<vkch::PipelineBarrier>(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::AccessFlagBits::eTransferWrite,
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite)
+          ->add<vkch::Work>(
+            std::tuple<unsigned int, unsigned int, unsigned int>(
+              static_cast<unsigned int>(
+                ((active_tiles - 1) / SOLVER_ACTIVE_BUILD_X) + 1), 1, 1),
+            flags_parity,
+            params_build_active,
+            program_build_active
+          )
+          ->add<vkch::PipelineBarrier>(
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::AccessFlagBits::eShaderWrite,
+            vk::PipelineStageFlagBits::eDrawIndirect |
+              vk::PipelineStageFlagBits::eComputeShader,
+            vk::AccessFlagBits::eIndirectCommandRead |
+              vk::AccessFlagBits::eShaderRead |
+              vk::AccessFlagBits::eShaderWrite)
+          ->add<vkch::WorkIndirect>(
+            tensor_active_dispatch, 0,
+            flags_parity,
+            (s % 2) ? params_active_BA : params_active_AB,
+            program_step
+          );
+      } else
+      {
+        schema_step_00_10->add<vkch::Work>(
+          solver_workgroup,
+          (medium_pushed) ? push_constants_media[s] : push_constants_step,
+          (s % 2) ? params_step_BA : params_step_AB,
+          program_step
+        );
+      }
+
+      if ((reduced < scheduled_recording.reduced_substeps.size()) &&
+        (scheduled_recording.reduced_substeps[reduced] == s))
+      {
+        // Partials per workgroup, then one workgroup into the ring.
+        schema_step_00_10
+          ->add<vkch::PipelineBarrier>()
+          ->add<vkch::Work>(
+            std::tuple<unsigned int, unsigned int, unsigned int>(
+              DIAGNOSTICS_REDUCTION_WORKGROUPS, 1, 1),
+            push_constants_reduce_partial,
+            (s % 2) ? params_reduce_BA : params_reduce_AB,
+            program_reduce
+          )
+          ->add<vkch::PipelineBarrier>()
+          ->add<vkch::Work>(
+            std::tuple<unsigned int, unsigned int, unsigned int>(1, 1, 1),
+            push_constants_reduce_final,
+            (s % 2) ? params_reduce_BA : params_reduce_AB,
+            program_reduce
+          );
+        reduced++;
+      }
+    } // s
+
+    if (!scheduled_recording.reduced_substeps.empty())
+    {
+      schema_step_00_10
+        ->add<vkch::PipelineBarrier>(
+          vk::PipelineStageFlagBits::eComputeShader,
+          vk::AccessFlagBits::eShaderWrite,
+          vk::PipelineStageFlagBits::eTransfer,
+          vk::AccessFlagBits::eTransferRead)
+        ->add<vkch::DownloadTensors>(diagnostics_download_tensors);
+    }
+    schema_step_00_10->make();
+  }
+
+  // Submits the scheduled steps followed by the render and the downloads
+  // due: the whole result for a checkpoint, and the readback region into the
+  // measurement slot unless it is negative.
   void submit(
     const bool first_run,
     const bool do_download,
-    std::shared_ptr<vkch::Schema> dependency
+    std::shared_ptr<vkch::Schema> dependency,
+    const int slot = -1
   )
   {
+    const double host_begin = thread_cpu_seconds();
     std::shared_ptr<vkch::Schema> actual_dependency;
     if (first_run)
     {
-      schema_upload->submitForAfter(dependency);
+      submit_schema(schema_upload, dependency);
       actual_dependency = schema_upload;
     }
-    schema_step_00_10->submitForAfter(
+    submit_schema(schema_step_00_10,
       (first_run) ? actual_dependency : dependency);
+    last_schema = schema_step_00_10;
 
     if (!no_gui)
     {
-      schema_renders->submitForAfter(schema_step_00_10);
-
+      submit_schema(schema_renders, schema_step_00_10);
+      last_schema = schema_renders;
     }
 
     if (do_download)
     {
-      schema_download->submitForAfter(
-        (no_gui) ? schema_step_00_10 : schema_renders);
+      submit_schema(schema_download,
+        (timeline != nullptr) ? schema_step_00_10 : last_schema);
       last_schema = schema_download;
+    }
+    if ((slot >= 0) && (transfer_timeline != nullptr))
+    {
+      submit_readback(slot);
+    } else if (slot >= 0)
+    {
+      submit_schema(schema_measurement_downloads[slot],
+        (timeline != nullptr) ? schema_step_00_10 : last_schema);
+      last_schema = schema_measurement_downloads[slot];
+    }
+    downloaded = do_download;
+    measurement_slot = slot;
+    host_seconds += thread_cpu_seconds() - host_begin;
+  }
+
+  // CPU time of the calling thread, without the time it waits.
+  static double thread_cpu_seconds()
+  {
+    timespec cpu_time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time);
+    return double(cpu_time.tv_sec) + 1e-9 * double(cpu_time.tv_nsec);
+  }
+
+  // The copy into tensor_readback follows the solver dispatches on the
+  // compute queue once the previous readback of this step has left it, and
+  // the download into the slot follows the copy on the transfer queue. The
+  // next submission only waits for the copy.
+  void submit_readback(const int slot)
+  {
+    schema_readback->submitOnTimelines(
+      transfer_timeline, readback_value, timeline, timeline->next());
+    last_schema = schema_readback;
+
+    readback_value = transfer_timeline->next();
+    schema_measurement_downloads[slot]->submitOnTimelines(
+      timeline, schema_readback->timelineValue(),
+      transfer_timeline, readback_value);
+  }
+
+  // Download the whole result of an already submitted step. Used when the
+  // host must finish reading the staging memory before it can be
+  // overwritten.
+  void submit_download(
+    std::shared_ptr<vkch::Schema> dependency
+  )
+  {
+    submit_schema(schema_download, dependency);
+    last_schema = schema_download;
+    downloaded = true;
+  }
+
+  // On the timeline the wait is for the value the dependency signalled, and
+  // so for everything submitted before it too.
+  void submit_schema(
+    std::shared_ptr<vkch::Schema> const &schema,
+    std::shared_ptr<vkch::Schema> const &dependency)
+  {
+    if (timeline != nullptr)
+    {
+      schema->submitOnTimeline(timeline,
+        (dependency != nullptr) ? dependency->timelineValue() : 0,
+        timeline->next());
     } else
     {
-      last_schema = (no_gui) ? schema_step_00_10 : schema_renders;
+      schema->submitForAfter(dependency);
     }
   }
 
@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "Sweep.hpp"
+#include "PackedFields.hpp"
+
+Sweep::Sweep(uint32_t iqueues_per_device, uintmax_t imemory_budget)
+  : _queues_per_device(iqueues_per_device)
+  , _memory_budget(imemory_budget)
+  , _stopping(false)
+  , _runs(nullptr)
+  , _stop_condition(nullptr)
+  , _in_progress(0)
+{}
+
+uintmax_t Sweep::memory_estimate(
+  SimulationParameters const &simulation_parameters)
+{
+  // Both field tensors, the other tensors are small in comparison.
+  if (PackedFields::enabled(simulation_parameters))
+  {
+    return 2 * PackedFields(simulation_parameters).size() * sizeof(float);
+  }
+  const uintmax_t member_count =
+    (simulation_parameters.ensembleSize() > 0) ?
+      uintmax_t(simulation_parameters.ensembleSize()) : 1;
+  return
+    2 * uintmax_t(simulation_parameters.voxelXCount()) *
+    uintmax_t(simulation_parameters.voxelYCount()) *
+    uintmax_t(simulation_parameters.voxelZCount()) *
+    SOLVER_FIELD_COUNT * sizeof(float) * member_count;
+}
+
+void Sweep::run(
+  std::vector<SimulationParameters> const &runs,
+  SweepStopCondition const &stop_condition,
+  void (*result_callback)(
+    SweepResult const &result,
+    void *user_pointer),
+  void *result_callback__user_pointer)
+{
+  open_devices();
+  if (_workers.empty())
+  {
+    fprintf(stderr, "No devices to run the sweep on.\n");
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _stopping = false;
+    _runs = &runs;
+    _stop_condition = &stop_condition;
+    _pending.clear();
+    for (size_t r = 0; r < runs.size(); r++)
+    {
+      _pending.push_back(r);
+    }
+    _results.clear();
+    _in_progress = 0;
+    _running.clear();
+  }
+
+  std::vector<std::thread> threads;
+  for (size_t w = 0; w < _workers.size(); w++)
+  {
+    threads.emplace_back(&Sweep::work, this, w);
+  }
+
+  // Pass results on as they arrive, until nothing is left to run.
+  for (;;)
+  {
+    SweepResult result;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+
+      _condition.wait(lock,
+        [this]()
+        {
+          return (!_results.empty()) ||
+            ((_in_progress == 0) && (_pending.empty() || _stopping));
+        });
+      if (_results.empty()) break;
+
+      result = std::move(_results.front());
+      _results.pop_front();
+    }
+
+    if (result_callback != nullptr)
+    {
+      (*result_callback)(result, result_callback__user_pointer);
+    }
+  }
+
+  for (size_t w = 0; w < threads.size(); w++)
+  {
+    threads[w].join();
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  _runs = nullptr;
+  _stop_condition = nullptr;
+  _pending.clear();
+}
+
+void Sweep::work(size_t iworker)
+{
+  Worker const &worker = _workers[iworker];
+  // Runs after the first reuse its allocations and programs that fit.
+  Simulation simulation;
+
+  for (;;)
+  {
+    size_t index = 0;
+    uintmax_t estimate = 0;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+
+      // The first pending run that fits the budget left on this device. A
+      // run larger than the whole budget only starts on an idle device.
+      bool found = false;
+      _condition.wait(lock,
+        [&]()
+        {
+          if (_stopping || _pending.empty()) return true;
+
+          for (std::deque<size_t>::iterator it = _pending.begin();
+            it != _pending.end(); ++it)
+          {
+            const uintmax_t run_estimate = memory_estimate((*_runs)[*it]);
+            if ((_device_used[worker.device] == 0) ||
+              ((_device_used[worker.device] + run_estimate) <=
+                _device_budget[worker.device]))
+            {
+              index = *it;
+              estimate = run_estimate;
+              _pending.erase(it);
+              found = true;
+              return true;
+            }
+          } // it
+          return false;
+        });
+      if (!found) return;
+
+      _device_used[worker.device] += estimate;
+      _in_progress++;
+      _running.push_back(&simulation);
+    }
+
+    RunState state;
+    state.sweep = this;
+    state.simulation = &simulation;
+    state.stop_condition = _stop_condition;
+    state.finished = false;
+    state.completed = false;
+    state.steps = 0;
+
+    simulation.set_measurement(&Sweep::measure, &state);
+    if (simulation.start((*_runs)[index], worker.vkch_ctxt))
+    {
+      simulation.wait();
+    }
+
+    SweepResult result;
+    result.index = index;
+    result.parameters = (*_runs)[index];
+    result.completed = state.completed;
+    result.steps = state.steps;
+    result.diagnostics = simulation.collected_diagnostics();
+    result.fields = std::move(state.fields);
+    result.device = worker.device;
+    result.queue = worker.queue;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _device_used[worker.device] -= estimate;
+    _in_progress--;
+    _running.erase(std::find(_running.begin(), _running.end(), &simulation));
+    _results.push_back(std::move(result));
+    _condition.notify_all();
+  }
+}
+
+void Sweep::measure(
+  SimulationState const &sim_state,
+  double time,
+  void *user_pointer)
+{
+  RunState &state = *reinterpret_cast<RunState *>(user_pointer);
+
+  // Ensembles finish as a whole, on the condition of their first member.
+  if (state.finished || (sim_state.member() != 0)) return;
+
+  state.steps = static_cast<uintmax_t>(time);
+
+  SweepStopCondition const &stop_condition = *(state.stop_condition);
+  bool reached = (state.steps >= stop_condition.maxSteps());
+  DiagnosticsSample sample;
+  if (((stop_condition.maxRadiusT() > 0) ||
+      (stop_condition.maxRadiusZ() > 0)) &&
+    state.simulation->latest_diagnostics(sample))
+  {
+    reached = reached ||
+      ((stop_condition.maxRadiusT() > 0) &&
+        (sample.max_radius_t() >= stop_condition.maxRadiusT())) ||
+      ((stop_condition.maxRadiusZ() > 0) &&
+        (sample.max_radius_z() >= stop_condition.maxRadiusZ()));
+  }
+
+  bool stopping = false;
+  {
+    std::lock_guard<std::mutex> lock(state.sweep->_mutex);
+
+    stopping = state.sweep->_stopping;
+  }
+
+  if (reached)
+  {
+    state.fields.assign(sim_state.fields(),
+      sim_state.fields() + sim_state.element_count());
+  }
+  if (reached || stopping)
+  {
+    state.finished = true;
+    state.completed = reached;
+    state.simulation->request_stop();
+  }
+}
+
+#if defined(SIMULATION_STUBS)
+// Cannot run simulation, no devices are opened.
+void Sweep::open_devices() {}
+#else // defined(SIMULATION_STUBS)
+
+// Physical device of a sweep context, by index.
+static uint32_t choose_sweep_device(
+  vk::raii::Instance const &instance,
+  std::vector<vk::raii::PhysicalDevice> &physical_device_options,
+  void *user_pointer)
+{
+  const uint32_t device = *reinterpret_cast<uint32_t *>(user_pointer);
+
+  return (device < physical_device_options.size()) ? device : 0;
+}
+
+// Further queues of the chosen compute family, up to the queues per device.
+static std::vector<std::pair<uint32_t, uint32_t> > open_sweep_queues(
+  vk::raii::PhysicalDevice const &physical_device,
+  std::vector<vk::QueueFamilyProperties> &queue_family_properties,
+  std::pair<uint32_t, uint32_t> &chosen_compute_index,
+  void *user_pointer)
+{
+  const uint32_t queues_per_device =
+    *reinterpret_cast<uint32_t *>(user_pointer);
+
+  std::vector<std::pair<uint32_t, uint32_t> > auxiliary_queues;
+  if (chosen_compute_index.first == static_cast<uint32_t>(-1))
+    return auxiliary_queues;
+
+  uint32_t queue_count =
+    queue_family_properties.at(chosen_compute_index.first).queueCount;
+  if ((queues_per_device > 0) && (queue_count > queues_per_device))
+  {
+    queue_count = queues_per_device;
+  }
+  for (uint32_t q = 1; q < queue_count; q++)
+  {
+    auxiliary_queues.emplace_back(chosen_compute_index.first, q);
+  }
+  return auxiliary_queues;
+}
+
+void Sweep::open_devices()
+{
+  if (!_workers.empty()) return;
+
+  uint32_t device_count = 1;
+  for (uint32_t device = 0; device < device_count; device++)
+  {
+    std::shared_ptr<vkch::Context> device_ctxt = nullptr;
+    try
+    {
+      device_ctxt =
+        vkch::Context::create(
+          nullptr, nullptr,
+          nullptr, nullptr,
+          &choose_sweep_device, &device,
+          &open_sweep_queues, &_queues_per_device,
+          nullptr, nullptr
+        );
+    }
+    catch (std::runtime_error &err)
+    {
+      fprintf(stderr, "Skipping device %u for the sweep: %s\n",
+        device, err.what());
+      // Budgets stay indexed by device.
+      _device_budget.push_back(0);
+      _device_used.push_back(0);
+      continue;
+    }
+    if (device == 0)
+    {
+      device_count = device_ctxt->physicalDeviceCount();
+    }
+
+    uintmax_t device_budget = _memory_budget;
+    if (device_budget == 0)
+    {
+      const vk::PhysicalDeviceMemoryProperties memory_properties =
+        device_ctxt->physical_device().getMemoryProperties();
+      for (uint32_t h = 0; h < memory_properties.memoryHeapCount; h++)
+      {
+        if ((memory_properties.memoryHeaps[h].flags &
+            vk::MemoryHeapFlagBits::eDeviceLocal) &&
+          ((memory_properties.memoryHeaps[h].size / 2) > device_budget))
+        {
+          device_budget = memory_properties.memoryHeaps[h].size / 2;
+        }
+      } // h
+    }
+    _device_budget.push_back(device_budget);
+    _device_used.push_back(0);
+
+    for (uint32_t q = 0; q < device_ctxt->computeQueueCount(); q++)
+    {
+      _workers.push_back(Worker{ device_ctxt->share(q), device, q });
+    }
+  } // device
+}
+
+#endif // else defined(SIMULATION_STUBS)
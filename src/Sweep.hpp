@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "solver_defaults.h"
+#include "SimulationParameters.h"
+#include "SimulationState.h"
+#include "DiagnosticsSample.hpp"
+#include "Simulation.hpp"
+
+// When a run of a sweep finishes, whichever is reached first. Checked at the
+// measurements of the run, so only on multiples of its measurement interval.
+struct SweepStopCondition
+{
+public:
+  inline SweepStopCondition()
+    : _max_steps(DEFAULT_SWEEP_MAX_STEPS)
+    , _max_radius_t(0)
+    , _max_radius_z(0)
+  {}
+
+  inline void setMaxSteps(uintmax_t imax_steps)
+  {
+    _max_steps = imax_steps;
+  }
+
+  inline uintmax_t maxSteps() const
+  {
+    return _max_steps;
+  }
+
+  // Crystal radii from the GPU diagnostics, zero for none. The run must
+  // have a diagnostics interval for these to be reached.
+  inline void setMaxRadiusT(int imax_radius_t)
+  {
+    _max_radius_t = (imax_radius_t < 0) ? 0 : imax_radius_t;
+  }
+
+  inline int maxRadiusT() const
+  {
+    return _max_radius_t;
+  }
+
+  inline void setMaxRadiusZ(int imax_radius_z)
+  {
+    _max_radius_z = (imax_radius_z < 0) ? 0 : imax_radius_z;
+  }
+
+  inline int maxRadiusZ() const
+  {
+    return _max_radius_z;
+  }
+
+private:
+  uintmax_t _max_steps;
+  int _max_radius_t;
+  int _max_radius_z;
+};
+
+// The outcome of one run of a sweep.
+struct SweepResult
+{
+public:
+  // Position of the run in the list given to the sweep.
+  size_t index;
+  SimulationParameters parameters;
+  // Whether the stop condition was reached, otherwise the run failed or the
+  // sweep was stopped.
+  bool completed;
+  // Step of the last measurement.
+  uintmax_t steps;
+  std::vector<DiagnosticsSample> diagnostics;
+  // Snapshot of the measurement that reached the stop condition, in the
+  // compact layout of the readback region of the parameters.
+  std::vector<float> fields;
+  // Physical device and compute queue the run was scheduled on.
+  uint32_t device;
+  uint32_t queue;
+
+  // Whether the result holds the final state, only runs that completed do.
+  inline bool has_state() const
+  {
+    return completed && !fields.empty();
+  }
+
+  // The final state, valid while this result is, if it has one.
+  inline SimulationState state() const
+  {
+    return SimulationState(fields.data(), parameters);
+  }
+};
+
+// Runs lists of simulation parameters concurrently, on every compute queue
+// of every physical device, each device with a budget of memory for the
+// runs scheduled on it. Results are passed back as each run finishes.
+class Sweep
+{
+public:
+  // At most the given number of compute queues are used per device, zero
+  // for all of them. A memory budget of zero is half of the largest device
+  // local heap of each device.
+  Sweep(uint32_t iqueues_per_device = 0, uintmax_t imemory_budget = 0);
+
+  inline ~Sweep()
+  {
+    request_stop();
+  }
+
+  // Run all of the parameters until the stop condition and return once the
+  // last has finished. The callback is called on the calling thread with
+  // each result, in order of completion.
+  void run(
+    std::vector<SimulationParameters> const &runs,
+    SweepStopCondition const &stop_condition,
+    void (*result_callback)(
+      SweepResult const &result,
+      void *user_pointer),
+    void *result_callback__user_pointer);
+
+  // Stop the runs in progress and skip those not yet started, e.g. from the
+  // result callback.
+  inline void request_stop()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _stopping = true;
+    for (size_t s = 0; s < _running.size(); s++)
+    {
+      if (_running[s]->is_running()) _running[s]->request_stop();
+    } // s
+    _condition.notify_all();
+  }
+
+  // Compute queues runs are scheduled on, over all devices. Devices are
+  // opened by the first run.
+  inline size_t worker_count() const
+  {
+    return _workers.size();
+  }
+
+  // Device memory taken by a run of the parameters, counted against the
+  // budget of the device it is scheduled on.
+  static uintmax_t memory_estimate(
+    SimulationParameters const &simulation_parameters);
+
+private:
+  struct Worker
+  {
+    std::shared_ptr<vkch::Context> vkch_ctxt;
+    uint32_t device;
+    uint32_t queue;
+  };
+
+  // State of a run shared with its measurement callback.
+  struct RunState
+  {
+    Sweep *sweep;
+    Simulation *simulation;
+    SweepStopCondition const *stop_condition;
+    bool finished;
+    bool completed;
+    uintmax_t steps;
+    std::vector<float> fields;
+  };
+
+  void open_devices();
+
+  void work(size_t iworker);
+
+  static void measure(
+    SimulationState const &sim_state,
+    double time,
+    void *user_pointer);
+
+  uint32_t _queues_per_device;
+  uintmax_t _memory_budget;
+
+  std::vector<Worker> _workers;
+  std::vector<uintmax_t> _device_budget;
+  std::vector<uintmax_t> _device_used;
+
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  bool _stopping;
+
+  // Of the current sweep, guarded by _mutex.
+  std::vector<SimulationParameters> const *_runs;
+  SweepStopCondition const *_stop_condition;
+  std::deque<size_t> _pending;
+  std::deque<SweepResult> _results;
+  size_t _in_progress;
+  // Simulations of the runs in progress.
+  std::vector<Simulation *> _running;
+};
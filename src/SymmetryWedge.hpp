@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "constants.h"
+#include "SimulationParameters.h"
+#include "ReadbackRegion.hpp"
+
+// Storage of the fundamental wedge 0 <= bj <= bi of the hexagonal torus, in
+// coordinates relative to the centre voxel, halved in z for D6H. Matches
+// wedge_element() in the solver_substep_wedge.comp family of shaders.
+struct SymmetryWedge
+{
+public:
+  SymmetryWedge(SymmetryMode isymmetry, int iradiusT, int iradiusZ)
+    : _symmetry(isymmetry)
+    , _radiusT(iradiusT)
+    , _radiusZ(iradiusZ)
+  {
+  }
+
+  explicit SymmetryWedge(SimulationParameters const &simulation_parameters)
+    : SymmetryWedge(
+      simulation_parameters.symmetry(),
+      simulation_parameters.radiusT(),
+      simulation_parameters.radiusZ())
+  {
+  }
+
+  int x_count() const { return _radiusT + 1; }
+  int y_count() const { return (_radiusT / 2) + 1; }
+  int z_count() const
+  {
+    return (_symmetry == SymmetryMode::D6H) ? (_radiusZ + 1) : (2 * _radiusZ);
+  }
+  // Layer of the storage holding bk == 0.
+  int z_offset() const
+  {
+    return (_symmetry == SymmetryMode::D6H) ? 0 : _radiusZ;
+  }
+
+  uintmax_t per_field_size() const
+  {
+    return uintmax_t(x_count()) * uintmax_t(y_count()) * uintmax_t(z_count());
+  }
+
+  // Move a voxel to its periodic image inside the domain, then to its
+  // symmetric image inside the wedge.
+  void canonicalise(int &bi, int &bj, int &bk) const
+  {
+    const int R = _radiusT;
+    for (int pass = 0; pass < 2; pass++)
+    {
+      if ((bi+bj) >= R) { bi -= R; bj -= R; }
+      if ((-(bi+bj)) > R) { bi += R; bj += R; }
+      if (bi >= R) { bi -= 2*R; bj += R; }
+      if ((-bi) > R) { bi += 2*R; bj -= R; }
+      if (bj >= R) { bi += R; bj -= 2*R; }
+      if ((-bj) > R) { bi -= R; bj += 2*R; }
+      if ((bi+bj) >= R) { bi -= R; bj -= R; }
+      if ((-(bi+bj)) > R) { bi += R; bj += R; }
+    } // pass
+    if (bk > _radiusZ) bk -= 2*_radiusZ;
+    if ((-bk) > _radiusZ) bk += 2*_radiusZ;
+
+    // Sixths of a turn into the sector bi > 0, bj >= 0, then the mirror
+    // across bi == bj.
+    for (int r = 0; r < 5; r++)
+    {
+      if (((bi >= 1) && (bj >= 0)) || ((bi == 0) && (bj == 0))) break;
+      const int rotated_bj = -bi;
+      bi += bj;
+      bj = rotated_bj;
+    } // r
+    if (bj > bi)
+    {
+      const int mirrored_bj = bi;
+      bi = bj;
+      bj = mirrored_bj;
+    }
+
+    // The layers at -radiusZ and radiusZ are updated identically.
+    if (_symmetry == SymmetryMode::D6H)
+    {
+      bk = abs(bk);
+    } else if (bk == _radiusZ)
+    {
+      bk = -_radiusZ;
+    }
+  }
+
+  uintmax_t element(int bi, int bj, int bk) const
+  {
+    canonicalise(bi, bj, bk);
+    return
+      (uintmax_t(bk + z_offset()) * uintmax_t(y_count()) + uintmax_t(bj)) *
+        uintmax_t(x_count()) +
+      uintmax_t(bi);
+  }
+
+  // Copy the wedge out of fields laid out over the full grid.
+  void gather(float const *all_fields, float *wedge_fields,
+    int x_size, int y_size, int z_size) const
+  {
+    const uintmax_t full_per_field_size =
+      uintmax_t(x_size) * uintmax_t(y_size) * uintmax_t(z_size);
+
+    uintmax_t e = 0;
+    for (int m = 0; m < SOLVER_FIELD_COUNT; m++)
+    {
+      for (int k = 0; k < z_count(); k++)
+      {
+        for (int j = 0; j < y_count(); j++)
+        {
+          for (int i = 0; i < x_count(); i++)
+          {
+            wedge_fields[e++] = all_fields[
+              uintmax_t(m) * full_per_field_size +
+              (uintmax_t(k - z_offset() + (z_size / 2)) * uintmax_t(y_size) +
+                uintmax_t(j + (y_size / 2))) * uintmax_t(x_size) +
+              uintmax_t(i + (x_size / 2))];
+          } // i
+        } // j
+      } // k
+    } // m
+  }
+
+  // Reconstruct the readback region of the full grid, in its compact layout,
+  // from the wedge. Voxels beyond the boundary shell are never updated by the
+  // solver and keep their quiescent values.
+  void expand(float const *wedge_fields, float *compact_fields,
+    int x_size, int y_size, int z_size,
+    ReadbackRegion const &readback,
+    float const (&quiescent)[SOLVER_FIELD_COUNT]) const
+  {
+    const int counts[3] = { x_size, y_size, z_size };
+    int begin[3], end[3];
+    readback.resolve(counts, begin, end);
+
+    const int radiusT_plus_boundary = _radiusT + BOUNDARY_THICKNESS;
+    const int radiusZ_plus_boundary = _radiusZ + BOUNDARY_THICKNESS;
+
+    uintmax_t e = 0;
+    for (int m = 0; m < SOLVER_FIELD_COUNT; m++)
+    {
+      if (!readback.field(m)) continue;
+
+      const float *wedge_field = &(wedge_fields[m * per_field_size()]);
+      for (int k = begin[2]; k < end[2]; k++)
+      {
+        const int bk = k - (z_size / 2);
+        for (int j = begin[1]; j < end[1]; j++)
+        {
+          const int bj = j - (y_size / 2);
+          for (int i = begin[0]; i < end[0]; i++)
+          {
+            const int bi = i - (x_size / 2);
+
+            const bool outside_boundary_condition =
+              ((-(bi+bj)) > radiusT_plus_boundary) ||
+              ((-bi) > radiusT_plus_boundary) ||
+              ((-bj) > radiusT_plus_boundary) ||
+              ((bi+bj) >= radiusT_plus_boundary) ||
+              (bi >= radiusT_plus_boundary) ||
+              (bj >= radiusT_plus_boundary) ||
+              ((-bk) > radiusZ_plus_boundary) ||
+              (bk >= radiusZ_plus_boundary);
+
+            compact_fields[e++] = (outside_boundary_condition) ?
+              quiescent[m] : wedge_field[element(bi, bj, bk)];
+          } // i
+        } // j
+      } // k
+    } // m
+  }
+
+private:
+  SymmetryMode _symmetry;
+  int _radiusT, _radiusZ;
+};
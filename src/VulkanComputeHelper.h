@@ -1,14 +1,24 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <cstdlib>
 #include <memory>
 #include <vector>
 #include <tuple>
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
 #include <mutex>
+#include <unistd.h>
 
 #define VULKAN_HPP_ENABLE_DYNAMIC_LOADER_TOOL 1
 
+// maxPushConstantsSize every Vulkan device supports.
+#define VKCH_MAX_PUSH_CONSTANTS_BYTES 128
+
 #include <vulkan/vulkan.hpp>
 #include <vulkan/vulkan_enums.hpp>
 #include <vulkan/vulkan_raii.hpp>
@@ -17,6 +27,7 @@ namespace vkComputeHelper
 {
   class Context;
   class Schema;
+  class Timeline;
   class Program;
   class TensorParameterSet;
   class Step;
@@ -37,6 +48,7 @@ namespace vkComputeHelper
     , _in_test_run_mode(std::move(other._in_test_run_mode))
     , _byte_ptr(std::move(other._byte_ptr))
     , _allocated_memory_size(std::move(other._allocated_memory_size))
+    , _memory_type_index(std::move(other._memory_type_index))
     , _mapped_memory_ptr(std::move(other._mapped_memory_ptr))
     {
       other._backing_device_memory = nullptr;
@@ -75,6 +87,7 @@ namespace vkComputeHelper
         _in_test_run_mode = std::move(other._in_test_run_mode);
         _byte_ptr = std::move(other._byte_ptr);
         _allocated_memory_size = std::move(other._allocated_memory_size);
+        _memory_type_index = std::move(other._memory_type_index);
         _mapped_memory_ptr = std::move(other._mapped_memory_ptr);
         other._backing_device_memory = nullptr;
         other._in_test_run_mode = true;
@@ -157,6 +170,19 @@ namespace vkComputeHelper
         return;
       }
 
+      // A recycled allocation is kept if the new allocations fit in it.
+      if (_backing_device_memory != nullptr)
+      {
+        if ((memory_requirements.size <= _allocated_memory_size) &&
+          (memory_type_index == _memory_type_index))
+        {
+          _in_test_run_mode = false;
+          _byte_ptr = 0;
+          return;
+        }
+        releaseBackingMemory();
+      }
+
       vk::MemoryAllocateInfo memory_allocation_info(
         memory_requirements.size, memory_type_index
       );
@@ -168,6 +194,7 @@ namespace vkComputeHelper
       // Don't bind memory, this is merely for demo purposes.
       _in_test_run_mode = false;
       _allocated_memory_size = memory_requirements.size;
+      _memory_type_index = memory_type_index;
       _byte_ptr = 0;
 
       if (MEMORY_PROPERTY_FLAGS ==
@@ -214,6 +241,15 @@ namespace vkComputeHelper
       return _in_test_run_mode;
     }
 
+    // Return to dry run mode once everything allocated from the pool has
+    // been released, keeping the backing allocation for the next pool if it
+    // is large enough.
+    inline void recycle()
+    {
+      _in_test_run_mode = true;
+      _byte_ptr = 0;
+    }
+
     inline void *getOffsetPointer(uintmax_t offset_bytes)
     {
       return
@@ -221,6 +257,25 @@ namespace vkComputeHelper
     }
 
     inline ~LinearMemoryPool()
+    {
+      releaseBackingMemory();
+    }
+
+  protected:
+    inline LinearMemoryPool(
+      vk::raii::PhysicalDevice const &iphysical_device,
+      vk::raii::Device const &idevice)
+    : _physical_device(&iphysical_device)
+    , _device(&idevice)
+    , _backing_device_memory(nullptr)
+    , _in_test_run_mode(true)
+    , _byte_ptr(0)
+    , _allocated_memory_size(0)
+    , _memory_type_index(uint32_t(-1))
+    , _mapped_memory_ptr(nullptr)
+    {}
+
+    inline void releaseBackingMemory()
     {
       if (_backing_device_memory != nullptr)
       {
@@ -242,22 +297,10 @@ namespace vkComputeHelper
           fprintf(stderr, "problem with linear memory pool, device memory may "
             "not have been released.\n");
         }
+        _allocated_memory_size = 0;
       }
     }
 
-  protected:
-    inline LinearMemoryPool(
-      vk::raii::PhysicalDevice const &iphysical_device,
-      vk::raii::Device const &idevice)
-    : _physical_device(&iphysical_device)
-    , _device(&idevice)
-    , _backing_device_memory(nullptr)
-    , _in_test_run_mode(true)
-    , _byte_ptr(0)
-    , _allocated_memory_size(0)
-    , _mapped_memory_ptr(nullptr)
-    {}
-
   private:
     vk::raii::PhysicalDevice const *_physical_device;
     vk::raii::Device const *_device;
@@ -266,6 +309,7 @@ namespace vkComputeHelper
     bool _in_test_run_mode;
     uintmax_t _byte_ptr;
     uintmax_t _allocated_memory_size;
+    uint32_t _memory_type_index;
 
     void *_mapped_memory_ptr;
   };
@@ -293,6 +337,10 @@ namespace vkComputeHelper
     friend class Context;
     friend class UploadTensors;
     friend class DownloadTensors;
+    friend class CopyTensor;
+    friend class FillTensor;
+    friend class WorkIndirect;
+    friend class QueueFamilyTransfer;
   public:
     inline Tensor(
       vk::raii::PhysicalDevice const &iphysical_device,
@@ -311,7 +359,10 @@ namespace vkComputeHelper
           (vk::BufferUsageFlagBits::eStorageBuffer |
            vk::BufferUsageFlagBits::eTransferSrc |
            vk::BufferUsageFlagBits::eTransferDst) :
-          vk::BufferUsageFlagBits::eStorageBuffer
+          (vk::BufferUsageFlagBits::eStorageBuffer |
+           vk::BufferUsageFlagBits::eIndirectBuffer |
+           vk::BufferUsageFlagBits::eTransferSrc |
+           vk::BufferUsageFlagBits::eTransferDst)
       );
 
       _buffer =
@@ -393,6 +444,19 @@ namespace vkComputeHelper
     }
 
   protected:
+    // No device buffer, for tensors only held in staging memory.
+    inline Tensor(
+      vk::raii::PhysicalDevice const &iphysical_device,
+      vk::raii::Device const &idevice,
+      std::size_t size_bytes)
+      : _physical_device(&iphysical_device)
+      , _device(&idevice)
+      , _tensor_size(size_bytes)
+      , _device_memory(nullptr)
+      , _device_memory_offset(0)
+      , _buffer(nullptr)
+    {}
+
     inline virtual vk::raii::Buffer const *getStagingBuffer() const = 0;
 
     vk::raii::PhysicalDevice const *_physical_device;
@@ -440,7 +504,7 @@ namespace vkComputeHelper
       _staging_buffer->bindMemory(
         **_staging_device_memory, _staging_device_memory_offset);
 
-      _mapped_data = reinterpret_cast<float *>(
+      _mapped_data = reinterpret_cast<T *>(
         ilsmp.getOffsetPointer(_staging_device_memory_offset));
     }
 
@@ -494,6 +558,82 @@ namespace vkComputeHelper
     T *_mapped_data;
   };
 
+  // Host visible staging memory without a device buffer, a destination for
+  // downloads of other tensors the host reads while they are in use again
+  // on the device. Not a parameter of programs.
+  template <typename T>
+  class StagingTensor : public Tensor
+  {
+    friend class Context;
+  protected:
+    inline StagingTensor(
+      vk::raii::PhysicalDevice const &iphysical_device,
+      vk::raii::Device const &idevice,
+      LinearStagingMemoryPool &ilsmp,
+      std::size_t ielement_count)
+      : Tensor(iphysical_device, idevice, ielement_count * sizeof(T))
+      , _staging_device_memory(nullptr)
+      , _mapped_data(nullptr)
+    {
+      vk::BufferCreateInfo buffer_create_info(
+        {}, _tensor_size,
+        vk::BufferUsageFlagBits::eTransferSrc |
+        vk::BufferUsageFlagBits::eTransferDst
+      );
+
+      _staging_buffer =
+        std::make_unique<vk::raii::Buffer>(
+          device(), buffer_create_info);
+
+      if (ilsmp.inTestMode())
+        ilsmp.allocatePool();
+
+      std::pair<std::shared_ptr<vk::raii::DeviceMemory>, uintmax_t>
+        allocation = ilsmp.allocate(_tensor_size);
+
+      _staging_device_memory = allocation.first;
+      _staging_device_memory_offset = allocation.second;
+
+      _staging_buffer->bindMemory(
+        **_staging_device_memory, _staging_device_memory_offset);
+
+      _mapped_data = reinterpret_cast<T *>(
+        ilsmp.getOffsetPointer(_staging_device_memory_offset));
+    }
+
+    inline virtual vk::raii::Buffer const *getStagingBuffer() const
+    {
+      return _staging_buffer.get();
+    }
+
+  public:
+    inline StagingTensor(StagingTensor &&other)
+    : Tensor(std::move(other))
+    , _staging_device_memory(std::move(other._staging_device_memory))
+    , _staging_device_memory_offset(other._staging_device_memory_offset)
+    , _staging_buffer(std::move(other._staging_buffer))
+    , _mapped_data(other._mapped_data)
+    {
+      other._mapped_data = nullptr;
+      other._staging_buffer = nullptr;
+      other._staging_device_memory = nullptr;
+    }
+
+    inline T *data() { return _mapped_data; }
+    inline T const *data() const { return _mapped_data; }
+
+    inline virtual ~StagingTensor()
+    {
+      _mapped_data = nullptr;
+    }
+
+  protected:
+    std::shared_ptr<vk::raii::DeviceMemory> _staging_device_memory;
+    uintmax_t _staging_device_memory_offset;
+    std::unique_ptr<vk::raii::Buffer> _staging_buffer;
+    T *_mapped_data;
+  };
+
   class StorageTensor : public Tensor
   {
     friend class Context;
@@ -662,6 +802,37 @@ namespace vkComputeHelper
     }
   };
 
+  // Pipelines created through the pipeline cache of a context. Whether a
+  // pipeline was found in the cache is only known when the device reports
+  // pipeline creation feedback.
+  struct PipelineCacheStatistics
+  {
+    uint32_t pipelines_created = 0;
+    // Programs of an earlier schema reused by the context instead.
+    uint32_t programs_reused = 0;
+    uint32_t pipelines_with_feedback = 0;
+    uint32_t cache_hits = 0;
+    double creation_seconds = 0.0;
+    double hit_seconds = 0.0;
+    double miss_seconds = 0.0;
+
+    double hitRate() const
+    {
+      return (pipelines_with_feedback > 0) ?
+        (double(cache_hits) / double(pipelines_with_feedback)) : 0.0;
+    }
+
+    // Estimated from the mean creation time of the misses.
+    double secondsSaved() const
+    {
+      const uint32_t misses = pipelines_with_feedback - cache_hits;
+      if ((misses == 0) || (cache_hits == 0)) return 0.0;
+      const double saved =
+        (double(cache_hits) * (miss_seconds / double(misses))) - hit_seconds;
+      return (saved > 0.0) ? saved : 0.0;
+    }
+  };
+
   class Program
   {
     friend class Context;
@@ -669,12 +840,22 @@ namespace vkComputeHelper
   protected:
     inline Program(
       vk::raii::Device const &idevice,
+      vk::raii::PipelineCache const &pipeline_cache,
+      bool creation_feedback,
       std::vector<ConstantBase> const &spec_consts,
       std::vector<ConstantBase> const &example_push_consts,
       TensorParameterSet const &example_tensor_parameter_set,
       std::vector<uint32_t> const &SPIRV,
       vk::raii::DescriptorSetLayout const *extra_descriptor_set = nullptr)
       : _device(idevice)
+      , _spirv(SPIRV)
+      , _spec_constant_data(constantData(spec_consts))
+      , _push_constant_size(constantData(example_push_consts).size())
+      , _descriptor_count(example_tensor_parameter_set.size())
+      , _extra_descriptor_set(extra_descriptor_set != nullptr)
+      , _creation_seconds(0.0)
+      , _creation_feedback(false)
+      , _cache_hit(false)
     {
       std::vector<vk::SpecializationMapEntry> specialization_entries;
       size_t size_total = 0;
@@ -771,18 +952,75 @@ namespace vkComputeHelper
         vk::Pipeline(),
         0);
 
-      vk::PipelineCacheCreateInfo pipeline_cache_info;
-      vk::raii::PipelineCache temporary_cache(_device, pipeline_cache_info);
+      vk::PipelineCreationFeedbackEXT pipeline_feedback;
+      vk::PipelineCreationFeedbackEXT stage_feedback;
+      vk::PipelineCreationFeedbackCreateInfoEXT feedback_info(
+        &pipeline_feedback, 1, &stage_feedback);
+      if (creation_feedback)
+        compute_pipeline_info.pNext = &feedback_info;
 
+      const std::chrono::steady_clock::time_point creation_start =
+        std::chrono::steady_clock::now();
       _pipeline = std::make_unique<vk::raii::Pipeline>(
-        _device.createComputePipeline(temporary_cache, compute_pipeline_info)
+        _device.createComputePipeline(pipeline_cache, compute_pipeline_info)
       );
+      _creation_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - creation_start).count();
+
+      if (creation_feedback &&
+        (pipeline_feedback.flags &
+          vk::PipelineCreationFeedbackFlagBitsEXT::eValid))
+      {
+        _creation_feedback = true;
+        _cache_hit = static_cast<bool>(pipeline_feedback.flags &
+          vk::PipelineCreationFeedbackFlagBitsEXT::eApplicationPipelineCacheHit);
+      }
+    }
+
+    // Whether this program is interchangeable with one created from the
+    // given arguments and no extra descriptor set, whose layouts would be
+    // identically defined.
+    inline bool matches(
+      std::vector<ConstantBase> const &spec_consts,
+      std::vector<ConstantBase> const &example_push_consts,
+      TensorParameterSet const &example_tensor_parameter_set,
+      std::vector<uint32_t> const &SPIRV) const
+    {
+      return
+        (!_extra_descriptor_set) &&
+        (_descriptor_count == example_tensor_parameter_set.size()) &&
+        (_push_constant_size == constantData(example_push_consts).size()) &&
+        (_spec_constant_data == constantData(spec_consts)) &&
+        (_spirv == SPIRV);
+    }
+
+    static inline std::vector<unsigned char> constantData(
+      std::vector<ConstantBase> const &consts)
+    {
+      std::vector<unsigned char> data;
+      for (size_t i = 0; i < consts.size(); i++)
+      {
+        unsigned char const *element_data =
+          reinterpret_cast<unsigned char const *>(consts[i].data());
+        data.insert(data.end(), element_data, element_data + consts[i].size());
+      } // i
+      return data;
     }
 
     vk::raii::Device const &_device;
     std::unique_ptr<vk::raii::PipelineLayout> _pipeline_layout;
     std::unique_ptr<vk::raii::ShaderModule> _shader_module;
     std::unique_ptr<vk::raii::Pipeline> _pipeline;
+
+    std::vector<uint32_t> _spirv;
+    std::vector<unsigned char> _spec_constant_data;
+    size_t _push_constant_size;
+    size_t _descriptor_count;
+    bool _extra_descriptor_set;
+
+    double _creation_seconds;
+    bool _creation_feedback;
+    bool _cache_hit;
   };
 
   class Step
@@ -820,26 +1058,186 @@ namespace vkComputeHelper
   class DownloadTensors : public Step
   {
   public:
-    DownloadTensors(std::vector<std::shared_ptr<Tensor> > const &tensors)
+    // With no regions the whole of each tensor is copied, otherwise only the
+    // given regions (in bytes) of each tensor are copied into staging. With
+    // destinations each tensor is copied into the staging memory of the
+    // destination of the same index instead of its own.
+    DownloadTensors(std::vector<std::shared_ptr<Tensor> > const &tensors,
+      std::vector<vk::BufferCopy> const &regions = {},
+      std::vector<std::shared_ptr<Tensor> > const &destinations = {})
       : temp_tensors(tensors)
+      , _regions(regions)
+      , _destinations(destinations)
     {}
 
     void recordCommands(vk::raii::CommandBuffer const &command_buffer)
     {
       for (size_t i = 0; i < temp_tensors.size(); i++)
       {
-        vk::BufferCopy buffer_copy(0, 0, temp_tensors[i]->size());
-        vk::raii::Buffer const *staging = temp_tensors[i]->getStagingBuffer();
-        command_buffer.copyBuffer(
-          **(temp_tensors[i]->_buffer),
-          **staging,
-          buffer_copy
-        );
+        vk::raii::Buffer const *staging = (_destinations.empty()) ?
+          temp_tensors[i]->getStagingBuffer() :
+          _destinations[i]->getStagingBuffer();
+        if (_regions.empty())
+        {
+          vk::BufferCopy buffer_copy(0, 0, temp_tensors[i]->size());
+          command_buffer.copyBuffer(
+            **(temp_tensors[i]->_buffer),
+            **staging,
+            buffer_copy
+          );
+        } else
+        {
+          command_buffer.copyBuffer(
+            **(temp_tensors[i]->_buffer),
+            **staging,
+            _regions
+          );
+        }
 
       } // i
     }
   
     std::vector<std::shared_ptr<Tensor> > const &temp_tensors;
+    std::vector<vk::BufferCopy> _regions;
+    std::vector<std::shared_ptr<Tensor> > _destinations;
+  };
+
+  // Copy regions, in bytes, of one device tensor into another on the device.
+  // The tensors may come from the memory pools of different contexts of the
+  // same device.
+  class CopyTensor : public Step
+  {
+  public:
+    CopyTensor(std::shared_ptr<Tensor> const &src_tensor,
+      std::shared_ptr<Tensor> const &dst_tensor,
+      std::vector<vk::BufferCopy> const &regions)
+      : _src_tensor(src_tensor)
+      , _dst_tensor(dst_tensor)
+      , _regions(regions)
+    {}
+
+    void recordCommands(vk::raii::CommandBuffer const &command_buffer)
+    {
+      command_buffer.copyBuffer(
+        **(_src_tensor->_buffer),
+        **(_dst_tensor->_buffer),
+        _regions
+      );
+    }
+
+    std::shared_ptr<Tensor> _src_tensor;
+    std::shared_ptr<Tensor> _dst_tensor;
+    std::vector<vk::BufferCopy> _regions;
+  };
+
+  // Fill a range of a device tensor, in bytes, with a repeated 32-bit value.
+  class FillTensor : public Step
+  {
+  public:
+    FillTensor(std::shared_ptr<Tensor> const &tensor,
+      vk::DeviceSize offset = 0,
+      vk::DeviceSize size = VK_WHOLE_SIZE,
+      uint32_t value = 0)
+      : _tensor(tensor)
+      , _offset(offset)
+      , _size(size)
+      , _value(value)
+    {}
+
+    void recordCommands(vk::raii::CommandBuffer const &command_buffer)
+    {
+      command_buffer.fillBuffer(
+        **(_tensor->_buffer), _offset, _size, _value);
+    }
+
+    std::shared_ptr<Tensor> _tensor;
+    vk::DeviceSize _offset;
+    vk::DeviceSize _size;
+    uint32_t _value;
+  };
+
+  class PipelineBarrier : public Step
+  {
+  public:
+    PipelineBarrier(
+      vk::PipelineStageFlags src_stages =
+        vk::PipelineStageFlagBits::eComputeShader,
+      vk::AccessFlags src_access =
+        vk::AccessFlagBits::eShaderWrite,
+      vk::PipelineStageFlags dst_stages =
+        vk::PipelineStageFlagBits::eComputeShader,
+      vk::AccessFlags dst_access =
+        vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite)
+    : _src_stages(src_stages)
+    , _src_access(src_access)
+    , _dst_stages(dst_stages)
+    , _dst_access(dst_access)
+    {}
+
+    void recordCommands(vk::raii::CommandBuffer const &command_buffer)
+    {
+      vk::MemoryBarrier memory_barrier(_src_access, _dst_access);
+
+      command_buffer.pipelineBarrier(
+        _src_stages, _dst_stages,
+        vk::DependencyFlags(),
+        memory_barrier,
+        nullptr,
+        nullptr
+      );
+    }
+
+    vk::PipelineStageFlags _src_stages;
+    vk::AccessFlags _src_access;
+    vk::PipelineStageFlags _dst_stages;
+    vk::AccessFlags _dst_access;
+  };
+
+  // One half of a queue family ownership transfer of whole tensors, which
+  // the tensors of a device need to be used by a queue of another family
+  // than the one that wrote them. The release is recorded at the end of a
+  // schema of the source family with the stages and access that wrote
+  // them, the acquire at the start of a schema of the destination family
+  // with the stages and access that use them, with a semaphore between the
+  // two submissions. Tensors the destination overwrites need no transfer.
+  class QueueFamilyTransfer : public Step
+  {
+  public:
+    QueueFamilyTransfer(
+      std::vector<std::shared_ptr<Tensor> > const &tensors,
+      uint32_t src_family,
+      uint32_t dst_family,
+      bool release,
+      vk::PipelineStageFlags stages,
+      vk::AccessFlags access)
+    : _release(release)
+    , _stages(stages)
+    {
+      for (size_t i = 0; i < tensors.size(); i++)
+      {
+        _barriers.emplace_back(
+          (release) ? access : vk::AccessFlags(),
+          (release) ? vk::AccessFlags() : access,
+          src_family, dst_family,
+          **(tensors[i]->_buffer), 0, VK_WHOLE_SIZE);
+      } // i
+    }
+
+    void recordCommands(vk::raii::CommandBuffer const &command_buffer)
+    {
+      command_buffer.pipelineBarrier(
+        (_release) ? _stages : vk::PipelineStageFlagBits::eTopOfPipe,
+        (_release) ? vk::PipelineStageFlagBits::eBottomOfPipe : _stages,
+        vk::DependencyFlags(),
+        nullptr,
+        _barriers,
+        nullptr
+      );
+    }
+
+    bool _release;
+    vk::PipelineStageFlags _stages;
+    std::vector<vk::BufferMemoryBarrier> _barriers;
   };
 
   class Work : public Step
@@ -862,19 +1260,21 @@ namespace vkComputeHelper
     {
       if (_push_consts.size() > 0)
       {
-        size_t size_total = 0;
-        for (int i = 0; i < _push_consts.size(); i++)
-          size_total += _push_consts[i].size();
-
-        std::unique_ptr<unsigned char[]> push_constants_data =
-          std::make_unique<unsigned char[]>(size_total);
+        // Staged on the stack, push constants fit the guaranteed minimum
+        // range of the device limits.
+        unsigned char push_constants_data[VKCH_MAX_PUSH_CONSTANTS_BYTES];
 
-        size_total = 0;
+        size_t size_total = 0;
         for (size_t i = 0; i < _push_consts.size(); i++)
         {
           const size_t this_element_size = _push_consts[i].size();
+          if ((size_total + this_element_size) >
+            VKCH_MAX_PUSH_CONSTANTS_BYTES)
+          {
+            throw std::runtime_error("Push constants exceed the range.");
+          }
           std::memcpy(
-            &((push_constants_data.get())[size_total]),
+            &(push_constants_data[size_total]),
             _push_consts[i].data(),
             this_element_size
           );
@@ -886,7 +1286,7 @@ namespace vkComputeHelper
           **(_program->_pipeline_layout),
           static_cast<VkShaderStageFlags>(vk::ShaderStageFlagBits::eCompute),
           0, size_total,
-          static_cast<void const *>(push_constants_data.get()) // random types
+          static_cast<void const *>(push_constants_data) // random types
         );
       }
 
@@ -914,6 +1314,12 @@ namespace vkComputeHelper
           nullptr);
       }
 
+      recordDispatch(command_buffer);
+    }
+
+    inline virtual void recordDispatch(
+      vk::raii::CommandBuffer const &command_buffer)
+    {
       command_buffer.dispatch(
         (std::get<0>(_workgroups) > 0) ? std::get<0>(_workgroups) : 1,
         (std::get<1>(_workgroups) > 0) ? std::get<1>(_workgroups) : 1,
@@ -928,6 +1334,99 @@ namespace vkComputeHelper
     vk::raii::DescriptorSet const *_extra_descriptor_set;
   };
 
+  // Work with the workgroup counts read on the device from a tensor, as
+  // three 32-bit counts at the given byte offset.
+  class WorkIndirect : public Work
+  {
+  public:
+    WorkIndirect(
+      std::shared_ptr<Tensor> const &indirect,
+      vk::DeviceSize indirect_offset,
+      std::vector<ConstantBase> const &push_consts,
+      std::shared_ptr<TensorParameterSet> const &parameters,
+      std::shared_ptr<Program> const &program,
+      vk::raii::DescriptorSet const *extra_descriptor_set = nullptr)
+    : Work(
+        std::tuple<unsigned int, unsigned int, unsigned int>(0, 0, 0),
+        push_consts, parameters, program, extra_descriptor_set)
+    , _indirect(indirect)
+    , _indirect_offset(indirect_offset)
+    {}
+
+    inline virtual void recordDispatch(
+      vk::raii::CommandBuffer const &command_buffer)
+    {
+      command_buffer.dispatchIndirect(
+        **(_indirect->_buffer), _indirect_offset);
+    }
+
+    std::shared_ptr<Tensor> _indirect;
+    vk::DeviceSize _indirect_offset;
+  };
+
+  // A timeline semaphore, Vulkan 1.2 or VK_KHR_timeline_semaphore, counting
+  // the submissions signalling it. Unlike the binary semaphore of a schema,
+  // any number of submissions and host threads may wait for a value, and the
+  // host blocks until it is reached instead of polling. Submissions to one
+  // queue signal their values in submission order, so waiting for a value
+  // waits for everything submitted before it as well.
+  class Timeline
+  {
+    friend class Context;
+  protected:
+    inline Timeline(vk::raii::Device const &idevice)
+    : _device(idevice)
+    {
+      const vk::StructureChain<vk::SemaphoreCreateInfo,
+        vk::SemaphoreTypeCreateInfo> semaphore_info(
+          vk::SemaphoreCreateInfo(),
+          vk::SemaphoreTypeCreateInfo(vk::SemaphoreType::eTimeline, 0)
+        );
+      _semaphore = std::make_unique<vk::raii::Semaphore>(
+        idevice.createSemaphore(semaphore_info.get<vk::SemaphoreCreateInfo>())
+      );
+    }
+
+  public:
+    // Reserves the value for the next submission to signal.
+    inline uint64_t next()
+    {
+      return ++_last_value;
+    }
+
+    // The value reserved last.
+    inline uint64_t last() const
+    {
+      return _last_value;
+    }
+
+    inline uint64_t completed() const
+    {
+      return _semaphore->getCounterValue();
+    }
+
+    // Blocks until the value is reached, zero returns at once.
+    inline void wait(uint64_t value) const
+    {
+      if (value == 0) return;
+
+      const vk::Semaphore semaphore = **_semaphore;
+      const vk::SemaphoreWaitInfo wait_info({}, 1, &semaphore, &value);
+      while (vk::Result::eTimeout ==
+        _device.waitSemaphores(wait_info, UINT64_MAX));
+    }
+
+    inline vk::Semaphore semaphore() const
+    {
+      return **_semaphore;
+    }
+
+  protected:
+    vk::raii::Device const &_device;
+    std::unique_ptr<vk::raii::Semaphore> _semaphore;
+    uint64_t _last_value = 0;
+  };
+
   class Schema : public std::enable_shared_from_this<Schema>
   {
     friend class Context;
@@ -987,17 +1486,19 @@ namespace vkComputeHelper
     inline std::shared_ptr<Schema> submitForAfter(
       const std::shared_ptr<Schema> &dependency)
     {
-      std::vector<vk::PipelineStageFlags> destinations;
-      if (dependency != nullptr)
-        destinations.push_back(vk::PipelineStageFlagBits::eComputeShader);
-      std::vector<vk::Semaphore> semaphores;
-      if (dependency != nullptr)
-        semaphores.push_back(**(dependency->_semaphore));
+      // Submitted every step, so nothing is allocated. Schemas may begin
+      // with transfers, and transfer queues have no shader stages, so every
+      // command waits.
+      const vk::PipelineStageFlags destination =
+        vk::PipelineStageFlagBits::eAllCommands;
+      const vk::Semaphore wait_semaphore = (dependency != nullptr) ?
+        **(dependency->_semaphore) : vk::Semaphore();
+      const vk::CommandBuffer command_buffer = **_command_buffer;
+      const vk::Semaphore signal_semaphore = **_semaphore;
       vk::SubmitInfo submit_info(
-        semaphores,
-        destinations,
-        **_command_buffer,
-        **_semaphore);
+        (dependency != nullptr) ? 1 : 0, &wait_semaphore, &destination,
+        1, &command_buffer,
+        1, &signal_semaphore);
 
       _device.resetFences(**_fence);
 
@@ -1005,10 +1506,66 @@ namespace vkComputeHelper
         std::lock_guard<std::mutex> guard(_queue_mutex);
         _queue.submit(submit_info, **_fence);
       }
+      _timeline = nullptr;
+      _timeline_value = 0;
+
+      return shared_from_this();
+    }
+
+    // Submits once the timeline reached wait_value, zero not to wait, and
+    // signals signal_value on it when done. Schemas submitted this way are
+    // waited for by their value rather than by schema, a later
+    // submitForAfter() must not depend on them.
+    inline std::shared_ptr<Schema> submitOnTimeline(
+      const std::shared_ptr<Timeline> &timeline,
+      const uint64_t wait_value,
+      const uint64_t signal_value)
+    {
+      return submitOnTimelines(timeline, wait_value, timeline, signal_value);
+    }
+
+    // As submitOnTimeline(), waiting for a value of another timeline than
+    // the one signalled, e.g. that of another queue. Each queue signals a
+    // timeline of its own, as their submissions complete in any order.
+    inline std::shared_ptr<Schema> submitOnTimelines(
+      const std::shared_ptr<Timeline> &wait_timeline,
+      const uint64_t wait_value,
+      const std::shared_ptr<Timeline> &signal_timeline,
+      const uint64_t signal_value)
+    {
+      // Submitted every step, so nothing is allocated.
+      const vk::PipelineStageFlags destination =
+        vk::PipelineStageFlagBits::eAllCommands;
+      const vk::Semaphore wait_semaphore = wait_timeline->semaphore();
+      const vk::Semaphore signal_semaphore = signal_timeline->semaphore();
+      const vk::CommandBuffer command_buffer = **_command_buffer;
+      const uint32_t wait_count = (wait_value > 0) ? 1 : 0;
+      const vk::TimelineSemaphoreSubmitInfo timeline_info(
+        wait_count, &wait_value,
+        1, &signal_value);
+      vk::SubmitInfo submit_info(
+        wait_count, &wait_semaphore, &destination,
+        1, &command_buffer,
+        1, &signal_semaphore,
+        &timeline_info);
+
+      {
+        std::lock_guard<std::mutex> guard(_queue_mutex);
+        _queue.submit(submit_info);
+      }
+      _timeline = signal_timeline;
+      _timeline_value = signal_value;
 
       return shared_from_this();
     }
 
+    // The value signalled by the last submission on a timeline, zero after
+    // one without.
+    inline uint64_t timelineValue() const
+    {
+      return _timeline_value;
+    }
+
     inline std::shared_ptr<Schema> submit()
     {
       return submitForAfter(nullptr);
@@ -1016,6 +1573,12 @@ namespace vkComputeHelper
 
     inline std::shared_ptr<Schema> waitForCompletion()
     {
+      if (_timeline != nullptr)
+      {
+        _timeline->wait(_timeline_value);
+        return shared_from_this();
+      }
+
       // Timeout is in nanoseconds.
       while (vk::Result::eTimeout ==
         _device.waitForFences( { **_fence }, VK_TRUE, 10000000 ));
@@ -1053,6 +1616,8 @@ namespace vkComputeHelper
     std::unique_ptr<vk::raii::CommandBuffer> _command_buffer;
     std::unique_ptr<vk::raii::Fence> _fence;
     std::unique_ptr<vk::raii::Semaphore> _semaphore;
+    std::shared_ptr<Timeline> _timeline;
+    uint64_t _timeline_value = 0;
     std::vector<std::shared_ptr<Step> > _steps;
   };
 
@@ -1087,7 +1652,7 @@ namespace vkComputeHelper
         void *user_pointer),
       void *device_extension_choice_cb__user_pointer)
     {
-      _context = std::make_unique<vk::raii::Context>();
+      _context = std::make_shared<vk::raii::Context>();
 
       bool needs_portability_requirements = false;
 
@@ -1199,7 +1764,7 @@ namespace vkComputeHelper
         1,
         "none",
         1,
-        VK_API_VERSION_1_1
+        VK_API_VERSION_1_2
       );
 
       vk::InstanceCreateInfo instance_create_info(
@@ -1213,7 +1778,7 @@ namespace vkComputeHelper
 
       try
       {
-        _instance = std::make_unique<vk::raii::Instance>(
+        _instance = std::make_shared<vk::raii::Instance>(
           *_context, instance_create_info
         );
       }
@@ -1240,7 +1805,7 @@ namespace vkComputeHelper
           physical_device_options, physical_device_choice_cb__user_pointer);
       }
 
-      _physical_device = std::make_unique<vk::raii::PhysicalDevice>(
+      _physical_device = std::make_shared<vk::raii::PhysicalDevice>(
         std::move(physical_device_options[_physical_device_index])
       );
 
@@ -1283,8 +1848,42 @@ namespace vkComputeHelper
 
       _compute_queue_family_index = chosen_compute_index;
 
+      // A family of transfer queues only, the copy engines of discrete
+      // devices, so that copies run beside the compute queue. Its first
+      // queue not already opened as an auxiliary one.
+      _transfer_queue_family_index = std::pair<uint32_t, uint32_t>(-1, -1);
+      for (std::vector<vk::QueueFamilyProperties>::size_type
+        i = 0;
+        i < queue_family_properties.size();
+        i++)
+      {
+        const vk::QueueFlags flags = queue_family_properties.at(i).queueFlags;
+        if (!(flags & vk::QueueFlagBits::eTransfer) ||
+          (flags & (vk::QueueFlagBits::eCompute |
+            vk::QueueFlagBits::eGraphics)))
+        {
+          continue;
+        }
+        uint32_t opened = 0;
+        for (size_t p = 0; p < _auxiliary_queue_family_indexes.size(); p++)
+        {
+          if (_auxiliary_queue_family_indexes[p].first == i) opened++;
+        } // p
+        if (opened < queue_family_properties.at(i).queueCount)
+        {
+          _transfer_queue_family_index =
+            std::pair<uint32_t, uint32_t>(i, opened);
+          break;
+        }
+      } // i
+
+      // Timeline semaphores are core from Vulkan 1.2 on.
+      const bool device_vulkan_1_2 =
+        (_physical_device->getProperties().apiVersion >= VK_API_VERSION_1_2);
       const char *device_extensions_to_look_for[] = {
-          "VK_KHR_portability_subset"
+          "VK_KHR_portability_subset",
+          VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME,
+          VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME
       };
       
       std::vector<std::string> device_extension_names_to_propose;
@@ -1315,13 +1914,37 @@ namespace vkComputeHelper
           device_extension_names_to_propose;
       }
       std::vector<const char *> device_extension_names_to_use;
+      bool timeline_semaphore_extension = false;
       for (int l = 0; l < device_extension_names_chosen.size(); l++)
       {
         device_extension_names_to_use.push_back(
           device_extension_names_chosen.at(l).c_str()
         );
+        if (device_extension_names_chosen.at(l) ==
+          VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME)
+        {
+          _pipeline_creation_feedback = true;
+        }
+        if (device_extension_names_chosen.at(l) ==
+          VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)
+        {
+          timeline_semaphore_extension = true;
+        }
       }
 
+      // Enabled whenever the device supports them, the extension is only
+      // needed before Vulkan 1.2.
+      vk::PhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore_features;
+      if (device_vulkan_1_2 || timeline_semaphore_extension)
+      {
+        _timeline_semaphores =
+          _physical_device->getFeatures2<vk::PhysicalDeviceFeatures2,
+            vk::PhysicalDeviceTimelineSemaphoreFeatures>()
+            .get<vk::PhysicalDeviceTimelineSemaphoreFeatures>()
+            .timelineSemaphore;
+      }
+      timeline_semaphore_features.timelineSemaphore = _timeline_semaphores;
+
 #if !defined(BUILD_PYTHON_BINDINGS)
       if (device_extension_names_to_use.size() > 0)
       {
@@ -1355,6 +1978,23 @@ namespace vkComputeHelper
           unique_queue_family_count.push_back(1);
         }
       }
+      if (hasTransferQueue())
+      {
+        bool matched_existing = false;
+        for (int k = 0; k < unique_queue_family.size(); k++)
+        {
+          if (unique_queue_family[k] == _transfer_queue_family_index.first)
+          {
+            unique_queue_family_count[k] = unique_queue_family_count[k] + 1;
+            matched_existing = true;
+          }
+        }
+        if (!matched_existing)
+        {
+          unique_queue_family.push_back(_transfer_queue_family_index.first);
+          unique_queue_family_count.push_back(1);
+        }
+      }
 
       const float queue_priority = 1.0f;
       std::vector<vk::DeviceQueueCreateInfo> queues_to_use;
@@ -1374,13 +2014,17 @@ namespace vkComputeHelper
         {},
         device_extension_names_to_use
       );
+      if (_timeline_semaphores)
+      {
+        device_create_info.pNext = &timeline_semaphore_features;
+      }
 
-      _device = std::make_unique<vk::raii::Device>(
+      _device = std::make_shared<vk::raii::Device>(
         _physical_device->createDevice(device_create_info));
       
       vk::PipelineCacheCreateInfo pipeline_cache_info;
 
-      _pipeline_cache = std::make_unique<vk::raii::PipelineCache>(
+      _pipeline_cache = std::make_shared<vk::raii::PipelineCache>(
         *_device, pipeline_cache_info
       );
 
@@ -1398,15 +2042,23 @@ namespace vkComputeHelper
         if (p < 0)
         {
           _compute_queue = opened_queue;
-          _compute_queue_mutex = std::make_unique<std::mutex>();
+          _compute_queue_mutex = std::make_shared<std::mutex>();
         } else
         {
           _auxiliary_queues.push_back(opened_queue);
           _auxiliary_queues_mutex.push_back(
-            std::make_unique<std::mutex>());
+            std::make_shared<std::mutex>());
         }
 
       } // p
+      if (hasTransferQueue())
+      {
+        _transfer_queue = std::make_shared<vk::raii::Queue>(
+          *_device,
+          _transfer_queue_family_index.first,
+          _transfer_queue_family_index.second);
+        _transfer_queue_mutex = std::make_shared<std::mutex>();
+      }
 
       // Make memory pools.
       lmp_device =
@@ -1473,6 +2125,68 @@ namespace vkComputeHelper
       return vk_ctxt;
     }
 
+    // A context sharing the instance, device, pipeline cache and queues of
+    // this one, with memory pools, tensors, programs and schemas of its own.
+    // Contexts sharing a device may be used from different threads, their
+    // submissions are serialised by the shared queue mutexes. Waiting for the
+    // device to idle would need every queue, so wait for schemas instead.
+    // Its schemas submit to the given one of computeQueueCount() queues.
+    std::shared_ptr<Context> share(uint32_t compute_queue = 0) const
+    {
+      std::shared_ptr<Context> shared_ctxt(new Context());
+      shared_ctxt->_context = _context;
+      shared_ctxt->_instance = _instance;
+      shared_ctxt->_physical_device = _physical_device;
+      shared_ctxt->_device = _device;
+      shared_ctxt->_pipeline_cache = _pipeline_cache;
+      shared_ctxt->_physical_device_index = _physical_device_index;
+      shared_ctxt->_compute_queue_family_index = _compute_queue_family_index;
+      shared_ctxt->_compute_queue_mutex = _compute_queue_mutex;
+      shared_ctxt->_compute_queue = _compute_queue;
+      shared_ctxt->_auxiliary_queue_family_indexes =
+        _auxiliary_queue_family_indexes;
+      shared_ctxt->_auxiliary_queues_mutex = _auxiliary_queues_mutex;
+      shared_ctxt->_auxiliary_queues = _auxiliary_queues;
+      shared_ctxt->_graphics_queue = _graphics_queue;
+      shared_ctxt->_transfer_queue_family_index = _transfer_queue_family_index;
+      shared_ctxt->_transfer_queue_mutex = _transfer_queue_mutex;
+      shared_ctxt->_transfer_queue = _transfer_queue;
+      shared_ctxt->_present_queue = _present_queue;
+      shared_ctxt->_pipeline_creation_feedback = _pipeline_creation_feedback;
+      shared_ctxt->_timeline_semaphores = _timeline_semaphores;
+
+      if (compute_queue > 0)
+      {
+        const int p = computeFamilyAuxiliaryQueue(compute_queue);
+        if (p < 0)
+        {
+          throw std::runtime_error("No such compute queue to share.");
+        }
+        shared_ctxt->_compute_queue_family_index =
+          _auxiliary_queue_family_indexes[p];
+        shared_ctxt->_compute_queue_mutex = _auxiliary_queues_mutex[p];
+        shared_ctxt->_compute_queue = _auxiliary_queues[p];
+      }
+
+      shared_ctxt->lmp_device =
+        std::make_unique<LinearDeviceMemoryPool>(
+          std::move(
+            LinearDeviceMemoryPool(
+              *_physical_device, *_device
+            )
+          )
+        );
+      shared_ctxt->lmp_staging =
+        std::make_unique<LinearStagingMemoryPool>(
+          std::move(
+            LinearStagingMemoryPool(
+              *_physical_device, *_device
+            )
+          )
+        );
+      return shared_ctxt;
+    }
+
     template <typename T>
     std::shared_ptr<StorageTensor> storageTensor(
       size_t element_count)
@@ -1509,6 +2223,25 @@ namespace vkComputeHelper
       return shared;
     }
 
+    template <typename T>
+    std::shared_ptr<StagingTensor<T> > stagingTensor(
+      size_t element_count)
+    {
+      std::shared_ptr<StagingTensor<T> > staging(
+        std::make_shared<StagingTensor<T> >(
+          std::move(
+            StagingTensor<T>(
+              *_physical_device, *_device, *(lmp_staging.get()),
+              element_count
+            )
+          )
+        )
+      );
+
+      _tensor.push_back(staging);
+      return staging;
+    }
+
     std::shared_ptr<TensorParameterSet> tensorParameterSet(
       const std::vector<std::shared_ptr<Tensor> > &tensor_set)
     {
@@ -1533,17 +2266,51 @@ namespace vkComputeHelper
       std::vector<uint32_t> const &spirv,
       vk::raii::DescriptorSetLayout const *extra_descriptor_set = nullptr)
     {
+      // Programs kept by recycle() are reused when nothing differs, except
+      // with an extra descriptor set whose layout may since have changed.
+      if (extra_descriptor_set == nullptr)
+      {
+        for (size_t i = 0; i < _program.size(); i++)
+        {
+          if (_program[i]->matches(
+            spec_constants, push_constants, *params, spirv))
+          {
+            _pipeline_cache_statistics.programs_reused++;
+            return _program[i];
+          }
+        } // i
+      }
+
       std::shared_ptr<Program> program(
         std::make_shared<Program>(
           std::move(
             Program(
-              *_device, spec_constants, push_constants,
+              *_device, *_pipeline_cache, _pipeline_creation_feedback,
+              spec_constants, push_constants,
               *params, spirv, extra_descriptor_set
             )
           )
         )
       );
 
+      _pipeline_cache_statistics.pipelines_created++;
+      _pipeline_cache_statistics.creation_seconds +=
+        program->_creation_seconds;
+      if (program->_creation_feedback)
+      {
+        _pipeline_cache_statistics.pipelines_with_feedback++;
+        if (program->_cache_hit)
+        {
+          _pipeline_cache_statistics.cache_hits++;
+          _pipeline_cache_statistics.hit_seconds +=
+            program->_creation_seconds;
+        } else
+        {
+          _pipeline_cache_statistics.miss_seconds +=
+            program->_creation_seconds;
+        }
+      }
+
       _program.push_back(program);
       return program;
     }
@@ -1566,6 +2333,51 @@ namespace vkComputeHelper
       return schema;
     }
 
+    // Schemas submitted to the transfer queue, of the transfer family. Tensors
+    // the compute queue wrote are released to the transfer family by a
+    // QueueFamilyTransfer at the end of a compute schema and acquired by one
+    // at the start of the transfer schema, which waits for the compute
+    // schema's semaphore.
+    std::shared_ptr<Schema> transferSchema()
+    {
+      if (!hasTransferQueue())
+      {
+        throw std::runtime_error("No transfer queue available on device.");
+      }
+
+      std::shared_ptr<Schema> schema(
+        std::make_shared<Schema>(
+          std::move(
+            Schema(
+              *_physical_device, *_device,
+              *_transfer_queue, *(_transfer_queue_mutex.get()),
+              _transfer_queue_family_index.first
+            )
+          )
+        )
+      );
+
+      _schema.push_back(schema);
+      return schema;
+    }
+
+    // Whether the device supports timeline(), chosen when the context was
+    // created.
+    bool timelineSemaphores() const
+    {
+      return _timeline_semaphores;
+    }
+
+    // Unlike schemas, timelines are not held by the context.
+    std::shared_ptr<Timeline> timeline()
+    {
+      if (!_timeline_semaphores)
+      {
+        throw std::runtime_error("Timeline semaphores not supported.");
+      }
+      return std::shared_ptr<Timeline>(new Timeline(*_device));
+    }
+
     vk::Instance instance()
     {
       return **_instance;
@@ -1586,6 +2398,102 @@ namespace vkComputeHelper
       return *_pipeline_cache;
     }
 
+    // Merge the pipeline cache serialised in the given file into the
+    // context's cache. Returns false, leaving the cache as it is, if the
+    // file is missing, unreadable or was written for another device or
+    // driver version. Contexts already made by share() keep the previous
+    // cache.
+    bool loadPipelineCache(std::string const &filename)
+    {
+      std::ifstream file(filename, std::ios::binary);
+      if (!file) return false;
+
+      PipelineCacheFileHeader header;
+      file.read(reinterpret_cast<char *>(&header), sizeof(header));
+      const PipelineCacheFileHeader expected_header =
+        pipelineCacheFileHeader(header.data_size);
+      if ((!file) ||
+        (std::memcmp(&header, &expected_header, sizeof(header)) != 0))
+      {
+        return false;
+      }
+
+      // The size in the header is only trusted once it matches the rest of
+      // the file, a truncated or corrupt file is not allocated for.
+      const std::streampos data_begin = file.tellg();
+      file.seekg(0, std::ios::end);
+      const std::streampos file_end = file.tellg();
+      file.seekg(data_begin);
+      if ((!file) || (data_begin < 0) || (file_end < data_begin) ||
+        (uint64_t(file_end - data_begin) != uint64_t(header.data_size)))
+      {
+        return false;
+      }
+
+      std::vector<uint8_t> data(header.data_size);
+      file.read(reinterpret_cast<char *>(data.data()), data.size());
+      if (!file) return false;
+
+      vk::PipelineCacheCreateInfo pipeline_cache_info(
+        vk::PipelineCacheCreateFlags(), data.size(), data.data());
+      std::shared_ptr<vk::raii::PipelineCache> loaded_cache =
+        std::make_shared<vk::raii::PipelineCache>(
+          *_device, pipeline_cache_info
+        );
+      loaded_cache->merge(**_pipeline_cache);
+      _pipeline_cache = std::move(loaded_cache);
+      return true;
+    }
+
+    // Serialise the pipeline cache to the given file, keyed by the device
+    // UUID and driver version. Each save writes a temporary file of its own
+    // beside it and replaces the file in one rename, so concurrent savers,
+    // in this process or others, never publish or read a partial cache.
+    // Returns false if it could not be written.
+    bool savePipelineCache(std::string const &filename) const
+    {
+      const std::vector<uint8_t> data = _pipeline_cache->getData();
+      const PipelineCacheFileHeader header =
+        pipelineCacheFileHeader(data.size());
+
+      std::vector<char> temporary_filename(
+        filename.begin(), filename.end());
+      const char suffix[] = ".XXXXXX";
+      temporary_filename.insert(temporary_filename.end(),
+        suffix, suffix + sizeof(suffix));
+      const int descriptor = mkstemp(temporary_filename.data());
+      if (descriptor < 0) return false;
+      FILE *file = fdopen(descriptor, "wb");
+      if (file == nullptr)
+      {
+        close(descriptor);
+        std::remove(temporary_filename.data());
+        return false;
+      }
+
+      bool written =
+        (fwrite(&header, sizeof(header), 1, file) == 1) &&
+        (fwrite(data.data(), 1, data.size(), file) == data.size());
+      written = (fclose(file) == 0) && written;
+      if (!written ||
+        (std::rename(temporary_filename.data(), filename.c_str()) != 0))
+      {
+        std::remove(temporary_filename.data());
+        return false;
+      }
+      return true;
+    }
+
+    PipelineCacheStatistics const &pipelineCacheStatistics() const
+    {
+      return _pipeline_cache_statistics;
+    }
+
+    void resetPipelineCacheStatistics()
+    {
+      _pipeline_cache_statistics = PipelineCacheStatistics();
+    }
+
     std::pair<uint32_t, uint32_t> computeQueueFamilyIndex() const
     {
       return _compute_queue_family_index;
@@ -1601,6 +2509,19 @@ namespace vkComputeHelper
       return _compute_queue_family_index.second;
     }
 
+    // Whether the device has a queue family for transfers only, whose queue
+    // transferSchema() submits to.
+    bool hasTransferQueue() const
+    {
+      return
+        (_transfer_queue_family_index.first != static_cast<uint32_t>(-1));
+    }
+
+    uint32_t transferQueueFamily() const
+    {
+      return _transfer_queue_family_index.first;
+    }
+
     std::shared_ptr<vk::raii::Queue> const &computeQueueFamilyQueue() const
     {
       return _compute_queue;
@@ -1611,6 +2532,32 @@ namespace vkComputeHelper
       return _compute_queue_mutex.get();
     }
 
+    // The compute queue and the auxiliary queues opened in its family.
+    uint32_t computeQueueCount() const
+    {
+      uint32_t count = 1;
+      for (size_t p = 0; p < _auxiliary_queue_family_indexes.size(); p++)
+      {
+        if (_auxiliary_queue_family_indexes[p].first ==
+          _compute_queue_family_index.first)
+        {
+          count++;
+        }
+      } // p
+      return count;
+    }
+
+    uint32_t physicalDeviceIndex() const
+    {
+      return _physical_device_index;
+    }
+
+    uint32_t physicalDeviceCount() const
+    {
+      return static_cast<uint32_t>(
+        _instance->enumeratePhysicalDevices().size());
+    }
+
     size_t auxiliaryQueueCount() const
     {
       return _auxiliary_queue_family_indexes.size();
@@ -1652,6 +2599,30 @@ namespace vkComputeHelper
       lmp_staging->dryrunAllocate(size_bytes);
     }
 
+    void dryrunStagingTensorAllocate(uintmax_t size_bytes)
+    {
+      lmp_staging->dryrunAllocate(size_bytes);
+    }
+
+    // Drop all tensors and schemas but keep the programs, to be reused by
+    // identical programs, and the memory pool allocations, to be reused by
+    // pools that fit in them. The device must be idle.
+    void recycle()
+    {
+      _tensor_parameter_set.clear();
+      _schema.clear();
+      _tensor.clear();
+      _program.erase(
+        std::remove_if(_program.begin(), _program.end(),
+          [](std::shared_ptr<Program> const &program)
+          {
+            return program->_extra_descriptor_set;
+          }),
+        _program.end());
+      lmp_device->recycle();
+      lmp_staging->recycle();
+    }
+
     void clear()
     {
       _tensor_parameter_set.clear();
@@ -1677,29 +2648,88 @@ namespace vkComputeHelper
     }
 
   private:
-    std::unique_ptr<vk::raii::Context> _context;
-    std::unique_ptr<vk::raii::Instance> _instance;
-    std::unique_ptr<vk::raii::PhysicalDevice> _physical_device;
-    std::unique_ptr<vk::raii::Device> _device;
-    std::unique_ptr<vk::raii::PipelineCache> _pipeline_cache;
+    inline Context()
+    {}
+
+    // Auxiliary queue of the compute queue family serving as the given
+    // compute queue, counting the compute queue itself as 0.
+    int computeFamilyAuxiliaryQueue(uint32_t compute_queue) const
+    {
+      uint32_t count = 0;
+      for (size_t p = 0; p < _auxiliary_queue_family_indexes.size(); p++)
+      {
+        if (_auxiliary_queue_family_indexes[p].first ==
+          _compute_queue_family_index.first)
+        {
+          count++;
+          if (count == compute_queue) return static_cast<int>(p);
+        }
+      } // p
+      return -1;
+    }
+
+    struct PipelineCacheFileHeader
+    {
+      char magic[8];
+      uint8_t device_uuid[VK_UUID_SIZE];
+      uint32_t driver_version;
+      uint32_t reserved;
+      uint64_t data_size;
+    };
+
+    PipelineCacheFileHeader pipelineCacheFileHeader(uint64_t data_size) const
+    {
+      const vk::StructureChain<
+        vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>
+          properties = _physical_device->getProperties2<
+            vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+
+      PipelineCacheFileHeader header;
+      std::memset(&header, 0, sizeof(header));
+      std::memcpy(header.magic, "VKCHPC01", sizeof(header.magic));
+      std::memcpy(header.device_uuid,
+        properties.get<vk::PhysicalDeviceIDProperties>().deviceUUID.data(),
+        VK_UUID_SIZE);
+      header.driver_version =
+        properties.get<vk::PhysicalDeviceProperties2>().properties
+          .driverVersion;
+      header.data_size = data_size;
+      return header;
+    }
+
+    // Shared with the contexts made by share().
+    std::shared_ptr<vk::raii::Context> _context;
+    std::shared_ptr<vk::raii::Instance> _instance;
+    std::shared_ptr<vk::raii::PhysicalDevice> _physical_device;
+    std::shared_ptr<vk::raii::Device> _device;
+    std::shared_ptr<vk::raii::PipelineCache> _pipeline_cache;
     std::unique_ptr<LinearDeviceMemoryPool> lmp_device;
     std::unique_ptr<LinearStagingMemoryPool> lmp_staging;
     uint32_t _physical_device_index;
 
     std::pair<uint32_t, uint32_t> _compute_queue_family_index;
-    std::unique_ptr<std::mutex> _compute_queue_mutex;
+    std::shared_ptr<std::mutex> _compute_queue_mutex;
     std::shared_ptr<vk::raii::Queue> _compute_queue;
 
     std::vector<std::pair<uint32_t, uint32_t> > _auxiliary_queue_family_indexes;
-    std::vector<std::unique_ptr<std::mutex> > _auxiliary_queues_mutex;
+    std::vector<std::shared_ptr<std::mutex> > _auxiliary_queues_mutex;
     std::vector<std::shared_ptr<vk::raii::Queue> > _auxiliary_queues;
 
     std::shared_ptr<vk::raii::Queue> _graphics_queue;
     std::shared_ptr<vk::raii::Queue> _present_queue;
 
+    std::pair<uint32_t, uint32_t> _transfer_queue_family_index =
+      std::pair<uint32_t, uint32_t>(-1, -1);
+    std::shared_ptr<std::mutex> _transfer_queue_mutex;
+    std::shared_ptr<vk::raii::Queue> _transfer_queue;
+
     std::vector<std::shared_ptr<Tensor> > _tensor;
     std::vector<std::shared_ptr<Schema> > _schema;
     std::vector<std::shared_ptr<Program> > _program;
     std::vector<std::shared_ptr<TensorParameterSet> > _tensor_parameter_set;
+
+    bool _pipeline_creation_feedback = false;
+    bool _timeline_semaphores = false;
+    PipelineCacheStatistics _pipeline_cache_statistics;
   };
 }
@@ -2,33 +2,207 @@
 #include "constants.h"
 #include "compute.h"
 #include "StepSimulation.h"
+#include "SymmetryWedge.hpp"
+#include "AdaptiveGrid.hpp"
+#include "MeasurementRing.hpp"
+#include "PackedFields.hpp"
 
 #include "Simulation.hpp"
 
 #include "shader_headers/solver_substep.comp.spv.h"
+#include "shader_headers/solver_substep_tiled.comp.spv.h"
+#include "shader_headers/solver_substep_blocked.comp.spv.h"
+#include "shader_headers/solver_substep_active.comp.spv.h"
+#include "shader_headers/build_active_tiles.comp.spv.h"
+#include "shader_headers/solver_substep_wedge.comp.spv.h"
+#include "shader_headers/solver_substep_ensemble.comp.spv.h"
+#include "shader_headers/solver_substep_pushed.comp.spv.h"
+#include "shader_headers/init_fields.comp.spv.h"
 #include "shader_headers/sample_occupancy.comp.spv.h"
+#include "shader_headers/reduce_diagnostics.comp.spv.h"
 
-void simulation_thread(
+bool simulate_grid(
+  Simulation &simulation,
   volatile int *stop_thread,
   bool no_gui,
   const std::shared_ptr<VolumeBuffers> &volume_buffers,
   std::shared_ptr<vkch::Context> &vkch_ctxt,
-  SimulationParameters const &simulation_parameters)
+  SimulationParameters const &final_parameters,
+  SimulationParameters const &simulation_parameters,
+  uintmax_t &current_timestep,
+  std::vector<float> &grid_fields,
+  SimulationParameters &grown_parameters,
+  ForkedFields &forked_fields,
+  CheckpointWriter *checkpoint_writer)
 {
-  // quiescent field values for initialisation / boundaries
+  // Grid growth is due once the depletion zone of the last diagnostics
+  // sample reaches the growth margin of the domain.
+  const bool adaptive_growth = final_parameters.adaptiveGrowth();
+  bool grow_T = false;
+  bool grow_Z = false;
+
+  // A fork is due once the steps scheduled reach the fork step. The
+  // branches of a fork begin from the forked fields instead.
+  const bool branches = (forked_fields.fields != nullptr);
+  const uintmax_t fork_step = (simulation_parameters.forks()) ?
+    static_cast<uintmax_t>(simulation_parameters.forkStep()) : 0;
+  auto fork_reached = [&]()
+  {
+    return (fork_step > 0) && (current_timestep >= fork_step);
+  };
+
+  // quiescent field values, as written outside the seed by init_fields.comp
   float initial_dirichlet_params[SOLVER_FIELD_COUNT] = {
     0.f,
     float(simulation_parameters.medium().rho()),
     0.f
   };
 
-  std::vector<uint32_t> spirv_solver_substep(
-    &(shader__solver_substep_comp[0]),
-    &(shader__solver_substep_comp[0]) + (
-      sizeof(shader__solver_substep_comp) /
-        sizeof(shader__solver_substep_comp[0])
-    )
-  );
+  // With a symmetry only the fundamental wedge is stored and updated.
+  const bool symmetry_enabled =
+    (simulation_parameters.symmetry() != SymmetryMode::NONE);
+  const SymmetryWedge wedge(simulation_parameters);
+  if ((simulation_parameters.symmetry() == SymmetryMode::D6H) &&
+    ((simulation_parameters.seed().thickness() % 2) == 0))
+  {
+    fprintf(stderr, "D6H symmetry needs a seed crystal of odd thickness, "
+      "to be symmetric in z.\n");
+    *stop_thread = 1;
+    return false;
+  }
+
+  // Measurements need at least one field over a box of at least one voxel.
+  const int final_counts[3] = {
+    final_parameters.voxelXCount(),
+    final_parameters.voxelYCount(),
+    final_parameters.voxelZCount()
+  };
+  if (final_parameters.readback().element_count(final_counts) == 0)
+  {
+    fprintf(stderr, "The readback region holds no field or no voxel of the "
+      "grid.\n");
+    *stop_thread = 1;
+    return false;
+  }
+
+  std::vector<uint32_t> spirv_solver_substep;
+  switch ((symmetry_enabled) ?
+    SolverKernel::DIRECT : simulation_parameters.solverKernel())
+  {
+    case SolverKernel::TILED:
+      spirv_solver_substep = std::vector<uint32_t>(
+        &(shader__solver_substep_tiled_comp[0]),
+        &(shader__solver_substep_tiled_comp[0]) + (
+          sizeof(shader__solver_substep_tiled_comp) /
+            sizeof(shader__solver_substep_tiled_comp[0])
+        )
+      );
+      break;
+    case SolverKernel::TEMPORAL_BLOCKED:
+      spirv_solver_substep = std::vector<uint32_t>(
+        &(shader__solver_substep_blocked_comp[0]),
+        &(shader__solver_substep_blocked_comp[0]) + (
+          sizeof(shader__solver_substep_blocked_comp) /
+            sizeof(shader__solver_substep_blocked_comp[0])
+        )
+      );
+      break;
+    case SolverKernel::ACTIVE_TILES:
+      spirv_solver_substep = std::vector<uint32_t>(
+        &(shader__solver_substep_active_comp[0]),
+        &(shader__solver_substep_active_comp[0]) + (
+          sizeof(shader__solver_substep_active_comp) /
+            sizeof(shader__solver_substep_active_comp[0])
+        )
+      );
+      break;
+    default:
+      spirv_solver_substep = std::vector<uint32_t>(
+        &(shader__solver_substep_comp[0]),
+        &(shader__solver_substep_comp[0]) + (
+          sizeof(shader__solver_substep_comp) /
+            sizeof(shader__solver_substep_comp[0])
+        )
+      );
+      break;
+  }
+  if (symmetry_enabled)
+  {
+    spirv_solver_substep = std::vector<uint32_t>(
+      &(shader__solver_substep_wedge_comp[0]),
+      &(shader__solver_substep_wedge_comp[0]) + (
+        sizeof(shader__solver_substep_wedge_comp) /
+          sizeof(shader__solver_substep_wedge_comp[0])
+      )
+    );
+  }
+
+  // An ensemble stacks its members' grids in z, with the medium of each
+  // member read from its record instead of the specialisation constants.
+  const bool ensemble_enabled = (simulation_parameters.ensembleSize() > 0);
+  const unsigned int member_count = (ensemble_enabled) ?
+    static_cast<unsigned int>(simulation_parameters.ensembleSize()) : 1;
+  if (ensemble_enabled)
+  {
+    spirv_solver_substep = std::vector<uint32_t>(
+      &(shader__solver_substep_ensemble_comp[0]),
+      &(shader__solver_substep_ensemble_comp[0]) + (
+        sizeof(shader__solver_substep_ensemble_comp) /
+          sizeof(shader__solver_substep_ensemble_comp[0])
+      )
+    );
+
+    const vk::PhysicalDeviceLimits limits =
+      vkch_ctxt->physical_device().getProperties().limits;
+    const uintmax_t ensemble_bytes =
+      uintmax_t(simulation_parameters.voxelXCount()) *
+      uintmax_t(simulation_parameters.voxelYCount()) *
+      uintmax_t(simulation_parameters.voxelZCount()) *
+      SOLVER_FIELD_COUNT * member_count * sizeof(float);
+    if ((ensemble_bytes > limits.maxStorageBufferRange) ||
+      ((uintmax_t(simulation_parameters.voxelZCount()) * member_count) >
+        limits.maxComputeWorkGroupCount[2]))
+    {
+      fprintf(stderr, "Ensemble of %u members is too large for the device, "
+        "use fewer members or smaller grids.\n", member_count);
+      *stop_thread = 1;
+      return false;
+    }
+  }
+
+  // Pushed media are read by the direct solver kernel from the push
+  // constants of each dispatch instead of the specialisation constants.
+  const bool medium_pushed =
+    (simulation_parameters.mediumMode() == MediumMode::PUSH_CONSTANTS) &&
+    (!symmetry_enabled) && (!ensemble_enabled);
+  if (medium_pushed)
+  {
+    spirv_solver_substep = std::vector<uint32_t>(
+      &(shader__solver_substep_pushed_comp[0]),
+      &(shader__solver_substep_pushed_comp[0]) + (
+        sizeof(shader__solver_substep_pushed_comp) /
+          sizeof(shader__solver_substep_pushed_comp[0])
+      )
+    );
+  }
+
+  // The packed layout is read by the direct solver kernel through the same
+  // pipelines, specialised to it.
+  const bool packed_layout = PackedFields::enabled(simulation_parameters);
+  const PackedFields packed(simulation_parameters);
+
+  if ((!symmetry_enabled) &&
+    (simulation_parameters.solverKernel() ==
+      SolverKernel::TEMPORAL_BLOCKED) &&
+    (vkch_ctxt->physical_device().getProperties().limits
+      .maxComputeSharedMemorySize < SOLVER_TEMPORAL_SHARED_BYTES))
+  {
+    fprintf(stderr, "Temporally blocked solver needs %d bytes of shared "
+      "memory, more than the device supports.\n",
+      SOLVER_TEMPORAL_SHARED_BYTES);
+    *stop_thread = 1;
+    return false;
+  }
   std::vector<uint32_t> spirv_render(
     &(shader__sample_occupancy_comp[0]),
     &(shader__sample_occupancy_comp[0]) + (
@@ -37,148 +211,501 @@ void simulation_thread(
     )
   );
 
+  std::vector<uint32_t> spirv_build_active(
+    &(shader__build_active_tiles_comp[0]),
+    &(shader__build_active_tiles_comp[0]) + (
+      sizeof(shader__build_active_tiles_comp) /
+        sizeof(shader__build_active_tiles_comp[0])
+    )
+  );
+
+  std::vector<uint32_t> spirv_reduce(
+    &(shader__reduce_diagnostics_comp[0]),
+    &(shader__reduce_diagnostics_comp[0]) + (
+      sizeof(shader__reduce_diagnostics_comp) /
+        sizeof(shader__reduce_diagnostics_comp[0])
+    )
+  );
+
+  std::vector<uint32_t> spirv_init(
+    &(shader__init_fields_comp[0]),
+    &(shader__init_fields_comp[0]) + (
+      sizeof(shader__init_fields_comp) /
+        sizeof(shader__init_fields_comp[0])
+    )
+  );
+
   StepSimulation Step_A;
   StepSimulation Step_B;
   Step_A.no_gui = Step_B.no_gui = no_gui;
+  Step_A.member_count = Step_B.member_count = member_count;
+  Step_A.medium_pushed = Step_B.medium_pushed = medium_pushed;
+  Step_A.packed_layout = Step_B.packed_layout = packed_layout;
+  // Without timeline semaphores each schema waits for the one before it,
+  // and the host polls their fences.
+  if (vkch_ctxt->timelineSemaphores())
+  {
+    Step_A.timeline = Step_B.timeline = vkch_ctxt->timeline();
+  }
 
   const uintmax_t per_field_size =
     uintmax_t(simulation_parameters.voxelXCount()) *
     uintmax_t(simulation_parameters.voxelYCount()) *
     uintmax_t(simulation_parameters.voxelZCount());
+  const uintmax_t stored_per_field_size =
+    (symmetry_enabled) ? wedge.per_field_size() : per_field_size;
+  const uintmax_t stored_member_size = (packed_layout) ?
+    packed.size() : (stored_per_field_size * SOLVER_FIELD_COUNT);
+  const uintmax_t stored_size = stored_member_size * member_count;
+  if (branches &&
+    (forked_fields.fields->size() != stored_member_size * sizeof(float)))
+  {
+    fprintf(stderr, "Forked fields do not fit the grid of the branches.\n");
+    *stop_thread = 1;
+    return false;
+  }
 
   // Dry run initended allocations on the memory pool first.
-  vkch_ctxt->dryrunSharedTensorAllocate(
-    per_field_size * SOLVER_FIELD_COUNT * sizeof(float));
-  vkch_ctxt->dryrunSharedTensorAllocate(
-    per_field_size * SOLVER_FIELD_COUNT * sizeof(float));
+  vkch_ctxt->dryrunSharedTensorAllocate(stored_size * sizeof(float));
+  vkch_ctxt->dryrunSharedTensorAllocate(stored_size * sizeof(float));
+  if (ensemble_enabled)
+  {
+    vkch_ctxt->dryrunSharedTensorAllocate(
+      member_count * ENSEMBLE_MEMBER_WORDS * sizeof(float));
+    vkch_ctxt->dryrunSharedTensorAllocate(
+      member_count * ENSEMBLE_MEMBER_WORDS * sizeof(float));
+  }
 
-  std::shared_ptr<vkch::SharedTensor<float> > tensor_0 =
-    vkch_ctxt->sharedTensor<float>(per_field_size * SOLVER_FIELD_COUNT);
-  Step_A.tensor_A = tensor_0;
-  Step_B.tensor_B = tensor_0;
+  // Measurements download the readback region of every member, compactly,
+  // or the whole wedge with a symmetry or packed fields, into slots of their
+  // own.
+  const bool compact_readback =
+    (!symmetry_enabled) && (!packed_layout) &&
+    !simulation_parameters.readback().is_full(
+      simulation_parameters.voxelXCount(),
+      simulation_parameters.voxelYCount(),
+      simulation_parameters.voxelZCount());
+  const int grid_counts[3] = {
+    simulation_parameters.voxelXCount(),
+    simulation_parameters.voxelYCount(),
+    simulation_parameters.voxelZCount()
+  };
+  const uintmax_t measurement_slot_size = (compact_readback) ?
+    (simulation_parameters.readback().element_count(grid_counts) *
+      member_count) :
+    stored_size;
+  const unsigned int measurement_depth =
+    static_cast<unsigned int>(simulation_parameters.measurementDepth());
+  for (unsigned int slot = 0; slot < measurement_depth; slot++)
+  {
+    vkch_ctxt->dryrunStagingTensorAllocate(
+      measurement_slot_size * sizeof(float));
+  } // slot
+  // Read back on a transfer queue where the device has one, through a copy
+  // of the region on the device per step, beside the next submission.
+  const bool transfer_readback =
+    (Step_A.timeline != nullptr) && vkch_ctxt->hasTransferQueue();
+  if (transfer_readback)
+  {
+    vkch_ctxt->dryrunStorageTensorAllocate(
+      measurement_slot_size * sizeof(float));
+    vkch_ctxt->dryrunStorageTensorAllocate(
+      measurement_slot_size * sizeof(float));
+  }
 
+  // Each submission records this many solver dispatches, advancing the
+  // solver by at least the requested steps per submission.
+  const unsigned int steps_per_dispatch =
+    static_cast<unsigned int>(simulation_parameters.stepsPerDispatch());
+  const unsigned int substeps =
+    ((static_cast<unsigned int>(simulation_parameters.stepsPerSubmit()) - 1) /
+      steps_per_dispatch) + 1;
+  const uintmax_t steps_per_submission =
+    uintmax_t(substeps) * steps_per_dispatch;
+  Step_A.substeps = Step_B.substeps = substeps;
+  Step_A.steps_per_dispatch = Step_B.steps_per_dispatch = steps_per_dispatch;
+
+  // Up to two submissions of reductions may be unread by the host at once.
+  const bool diagnostics_enabled =
+    (simulation_parameters.diagnosticsInterval() > 0);
+  const uintmax_t diagnostics_ring_capacity =
+    (DIAGNOSTICS_RING_CAPACITY > (2 * uintmax_t(substeps))) ?
+      DIAGNOSTICS_RING_CAPACITY : (2 * uintmax_t(substeps));
+  const uintmax_t diagnostics_ring_words =
+    DIAGNOSTICS_HEADER_WORDS +
+    diagnostics_ring_capacity * DIAGNOSTICS_RECORD_WORDS;
+  const uintmax_t diagnostics_partials_words =
+    DIAGNOSTICS_REDUCTION_WORKGROUPS * DIAGNOSTICS_RECORD_WORDS;
+  if (diagnostics_enabled)
+  {
+    vkch_ctxt->dryrunSharedTensorAllocate(
+      diagnostics_ring_words * sizeof(uint32_t));
+    vkch_ctxt->dryrunStorageTensorAllocate(
+      diagnostics_partials_words * sizeof(uint32_t));
+  }
+
+  // Active tile list with its dispatch counts, and two halves of per-tile
+  // changed flags.
+  const bool active_tiles_enabled =
+    (!symmetry_enabled) &&
+    (simulation_parameters.solverKernel() == SolverKernel::ACTIVE_TILES);
+  const uintmax_t active_tile_count =
+    StepSimulation::active_tile_count(simulation_parameters);
+  if (active_tiles_enabled)
+  {
+    vkch_ctxt->dryrunStorageTensorAllocate(
+      (SOLVER_ACTIVE_HEADER_WORDS + active_tile_count) * sizeof(uint32_t));
+    vkch_ctxt->dryrunStorageTensorAllocate(
+      2 * active_tile_count * sizeof(uint32_t));
+  }
+
+  std::shared_ptr<vkch::SharedTensor<float> > tensor_0 =
+    vkch_ctxt->sharedTensor<float>(stored_size);
   std::shared_ptr<vkch::SharedTensor<float> > tensor_1 =
-    vkch_ctxt->sharedTensor<float>(per_field_size * SOLVER_FIELD_COUNT);
+    vkch_ctxt->sharedTensor<float>(stored_size);
+
+  std::vector<std::shared_ptr<vkch::StagingTensor<float> > >
+    measurement_slots;
+  for (unsigned int slot = 0; slot < measurement_depth; slot++)
+  {
+    measurement_slots.push_back(
+      vkch_ctxt->stagingTensor<float>(measurement_slot_size));
+    Step_A.measurement_slots.push_back(measurement_slots.back());
+    Step_B.measurement_slots.push_back(measurement_slots.back());
+  } // slot
+  std::shared_ptr<vkch::Timeline> transfer_timeline;
+  if (transfer_readback)
+  {
+    transfer_timeline = vkch_ctxt->timeline();
+    Step_A.transfer_timeline = Step_B.transfer_timeline = transfer_timeline;
+    Step_A.tensor_readback =
+      vkch_ctxt->storageTensor<float>(measurement_slot_size);
+    Step_B.tensor_readback =
+      vkch_ctxt->storageTensor<float>(measurement_slot_size);
+  }
+
+  // Step B begins from wherever step A leaves its result, which for an even
+  // substep count is back in the tensor step A started from.
+  Step_A.tensor_A = tensor_0;
   Step_A.tensor_B = tensor_1;
-  Step_B.tensor_A = tensor_1;
+  Step_B.tensor_A = Step_A.result_tensor();
+  Step_B.tensor_B = (Step_B.tensor_A == tensor_0) ? tensor_1 : tensor_0;
 
-  for (int m = 0; m < SOLVER_FIELD_COUNT; m++)
+  if (active_tiles_enabled)
   {
-    for (int p = 0; p < per_field_size; p++)
+    Step_A.tensor_active_dispatch = Step_B.tensor_active_dispatch =
+      vkch_ctxt->storageTensor<uint32_t>(
+        SOLVER_ACTIVE_HEADER_WORDS + active_tile_count);
+    Step_A.tensor_tile_flags = Step_B.tensor_tile_flags =
+      vkch_ctxt->storageTensor<uint32_t>(2 * active_tile_count);
+  }
+
+  // Members start active, the host clears the flag of a member once it is
+  // asked to stop and the steps upload it with their next submission.
+  std::vector<bool> member_active(member_count, true);
+  unsigned int members_remaining = member_count;
+  if (ensemble_enabled)
+  {
+    simulation.reset_members_stopping(static_cast<int>(member_count));
+
+    for (StepSimulation *step : { &Step_A, &Step_B })
     {
-      Step_A.tensor_A->data()[m*per_field_size + p] =
-        initial_dirichlet_params[m];
-    }
+      step->tensor_members =
+        vkch_ctxt->sharedTensor<float>(member_count * ENSEMBLE_MEMBER_WORDS);
+
+      float *record = step->tensor_members->data();
+      for (unsigned int m = 0; m < member_count; m++)
+      {
+        Medium const &medium = simulation_parameters.ensembleMedia()[m];
+        const float kappa[8] = { 0.f,
+          float(medium.kappa_01()), float(medium.kappa_10()),
+          float(medium.kappa_11()), float(medium.kappa_20()),
+          float(medium.kappa_21()), float(medium.kappa_30()),
+          float(medium.kappa_31()) };
+        const float mu[8] = { 0.f,
+          float(medium.mu_01()), float(medium.mu_10()),
+          float(medium.mu_11()), float(medium.mu_20()),
+          float(medium.mu_21()), float(medium.mu_30()),
+          float(medium.mu_31()) };
+        const float beta[8] = { 0.f,
+          float(medium.beta_01()), float(medium.beta_10()),
+          float(medium.beta_11()), float(medium.beta_20()),
+          float(medium.beta_21()), float(medium.beta_30()),
+          float(medium.beta_31()) };
+
+        std::fill(record, record + ENSEMBLE_MEMBER_WORDS, 0.f);
+        record[ENSEMBLE_MEMBER_ACTIVE] = 1.f;
+        record[ENSEMBLE_MEMBER_RHO] = float(medium.rho());
+        record[ENSEMBLE_MEMBER_PHI] = float(medium.phi());
+        std::copy(kappa, kappa + 8, record + ENSEMBLE_MEMBER_KAPPA);
+        std::copy(mu, mu + 8, record + ENSEMBLE_MEMBER_MU);
+        std::copy(beta, beta + 8, record + ENSEMBLE_MEMBER_BETA);
+        record += ENSEMBLE_MEMBER_WORDS;
+      } // m
+    } // step
+
+    Step_A.push_constants_step = Step_B.push_constants_step = {
+      vkch::Constant<uint32_t>(0)
+    };
+    Step_A.push_constants_init = Step_B.push_constants_init = {
+      vkch::Constant<uint32_t>(1)
+    };
   }
 
-  const int64_t ctre_idx =
-    (uintmax_t(simulation_parameters.voxelZCount()) / 2)*
-    uintmax_t(simulation_parameters.voxelYCount())*
-    uintmax_t(simulation_parameters.voxelXCount()) +
-    (uintmax_t(simulation_parameters.voxelYCount()) / 2)*
-    uintmax_t(simulation_parameters.voxelXCount()) +
-    (uintmax_t(simulation_parameters.voxelXCount()) / 2);
+  std::shared_ptr<vkch::StorageTensor> tensor_diagnostics_partials = nullptr;
+  if (diagnostics_enabled)
+  {
+    Step_A.tensor_diagnostics_ring = Step_B.tensor_diagnostics_ring =
+      vkch_ctxt->sharedTensor<uint32_t>(diagnostics_ring_words);
+    tensor_diagnostics_partials =
+      vkch_ctxt->storageTensor<uint32_t>(diagnostics_partials_words);
+  }
 
-  for (int k = -(simulation_parameters.seed().thickness() / 2);
-    k < (simulation_parameters.seed().thickness() -
-      (simulation_parameters.seed().thickness() / 2)); k++)
+  // Fields carried over from the previous grid of adaptive growth are
+  // uploaded, laid out over the full grid with the wedge copied out of them.
+  // Otherwise init_fields.comp writes the initial fields on the device.
+  const bool fields_carried_over = !grid_fields.empty();
+  if (branches)
   {
-    for (int j = -simulation_parameters.seed().radius();
-      j < (simulation_parameters.seed().radius() + 1); j++)
+    Step_A.tensor_fork_source = forked_fields.fields;
+  }
+  if (fields_carried_over)
+  {
+    if (symmetry_enabled)
     {
-      for (int i = -simulation_parameters.seed().radius();
-        i < (simulation_parameters.seed().radius() + 1); i++)
-      {
-        if ((abs(i+j) < (simulation_parameters.seed().radius() + 1)) &&
-            (abs(i) < (simulation_parameters.seed().radius() + 1)) &&
-            (abs(j) < (simulation_parameters.seed().radius() + 1)))
-        {
-          Step_A.tensor_A->data()[ctre_idx +
-            k*
-            uintmax_t(simulation_parameters.voxelYCount())*
-            uintmax_t(simulation_parameters.voxelXCount()) +
-            j*
-            uintmax_t(simulation_parameters.voxelXCount()) +
-            i] = 1.f;
-        }
+      wedge.gather(grid_fields.data(), Step_A.tensor_A->data(),
+        simulation_parameters.voxelXCount(),
+        simulation_parameters.voxelYCount(),
+        simulation_parameters.voxelZCount());
+    } else if (packed_layout)
+    {
+      packed.pack(grid_fields.data(), Step_A.tensor_A->data());
+    } else
+    {
+      std::copy(grid_fields.begin(), grid_fields.end(),
+        Step_A.tensor_A->data());
+    }
+    grid_fields.clear();
+    grid_fields.shrink_to_fit();
+  }
 
-      } // i
-
-    } // j
-
-  } // k
-
-  std::vector<vkch::ConstantBase> spec_constants_step = {
-    // Voxel sizes
-    vkch::Constant<float>(simulation_parameters.voxelXCount()), // 0
-    vkch::Constant<float>(simulation_parameters.voxelYCount()), // 1
-    vkch::Constant<float>(simulation_parameters.voxelZCount()), // 2
-    vkch::Constant<float>(simulation_parameters.radiusT()), // 3
-    vkch::Constant<float>(simulation_parameters.radiusZ()), // 4
-
-    // Simulation parameters
-    vkch::Constant<float>(simulation_parameters.medium().rho()), // 5
-    vkch::Constant<float>(simulation_parameters.medium().phi()), // 6
-
-    vkch::Constant<float>(simulation_parameters.medium().kappa_01()), // 7
-    vkch::Constant<float>(simulation_parameters.medium().kappa_10()), // 8
-    vkch::Constant<float>(simulation_parameters.medium().kappa_11()), // 9
-    vkch::Constant<float>(simulation_parameters.medium().kappa_20()), // 10
-    vkch::Constant<float>(simulation_parameters.medium().kappa_21()), // 11
-    vkch::Constant<float>(simulation_parameters.medium().kappa_30()), // 12
-    vkch::Constant<float>(simulation_parameters.medium().kappa_31()), // 13
-    vkch::Constant<float>(simulation_parameters.medium().mu_01()), // 14
-    vkch::Constant<float>(simulation_parameters.medium().mu_10()), // 15
-    vkch::Constant<float>(simulation_parameters.medium().mu_11()), // 16
-    vkch::Constant<float>(simulation_parameters.medium().mu_20()), // 17
-    vkch::Constant<float>(simulation_parameters.medium().mu_21()), // 18
-    vkch::Constant<float>(simulation_parameters.medium().mu_30()), // 19
-    vkch::Constant<float>(simulation_parameters.medium().mu_31()), // 20
-
-    vkch::Constant<float>(simulation_parameters.medium().beta_01()), // 21
-    vkch::Constant<float>(simulation_parameters.medium().beta_10()), // 22
-    vkch::Constant<float>(simulation_parameters.medium().beta_11()), // 23
-    vkch::Constant<float>(simulation_parameters.medium().beta_20()), // 24
-    vkch::Constant<float>(simulation_parameters.medium().beta_21()), // 25
-    vkch::Constant<float>(simulation_parameters.medium().beta_30()), // 26
-    vkch::Constant<float>(simulation_parameters.medium().beta_31()), // 27
-  };
+  // The solver is specialised to the medium scheduled at the step it starts
+  // from, everything else to the initial medium.
+  auto specialise = [&](Medium const &solver_medium)
+  {
+    return std::vector<vkch::ConstantBase>{
+      // Voxel sizes
+      vkch::Constant<float>(simulation_parameters.voxelXCount()), // 0
+      vkch::Constant<float>(simulation_parameters.voxelYCount()), // 1
+      vkch::Constant<float>(simulation_parameters.voxelZCount()), // 2
+      vkch::Constant<float>(simulation_parameters.radiusT()), // 3
+      vkch::Constant<float>(simulation_parameters.radiusZ()), // 4
 
-  uintmax_t current_timestep = 0;
+      // Simulation parameters
+      vkch::Constant<float>(simulation_parameters.medium().rho()), // 5
+      vkch::Constant<float>(simulation_parameters.medium().phi()), // 6
+
+      vkch::Constant<float>(solver_medium.kappa_01()), // 7
+      vkch::Constant<float>(solver_medium.kappa_10()), // 8
+      vkch::Constant<float>(solver_medium.kappa_11()), // 9
+      vkch::Constant<float>(solver_medium.kappa_20()), // 10
+      vkch::Constant<float>(solver_medium.kappa_21()), // 11
+      vkch::Constant<float>(solver_medium.kappa_30()), // 12
+      vkch::Constant<float>(solver_medium.kappa_31()), // 13
+      vkch::Constant<float>(solver_medium.mu_01()), // 14
+      vkch::Constant<float>(solver_medium.mu_10()), // 15
+      vkch::Constant<float>(solver_medium.mu_11()), // 16
+      vkch::Constant<float>(solver_medium.mu_20()), // 17
+      vkch::Constant<float>(solver_medium.mu_21()), // 18
+      vkch::Constant<float>(solver_medium.mu_30()), // 19
+      vkch::Constant<float>(solver_medium.mu_31()), // 20
+
+      vkch::Constant<float>(solver_medium.beta_01()), // 21
+      vkch::Constant<float>(solver_medium.beta_10()), // 22
+      vkch::Constant<float>(solver_medium.beta_11()), // 23
+      vkch::Constant<float>(solver_medium.beta_20()), // 24
+      vkch::Constant<float>(solver_medium.beta_21()), // 25
+      vkch::Constant<float>(solver_medium.beta_30()), // 26
+      vkch::Constant<float>(solver_medium.beta_31()), // 27
+
+      // Solver kernel parameters
+      vkch::Constant<int32_t>(
+        simulation_parameters.temporalBlockingSteps()), // 28
+      vkch::Constant<int32_t>(
+        static_cast<int32_t>(simulation_parameters.symmetry())), // 29
+      vkch::Constant<float>(
+        simulation_parameters.growthDepletionTolerance()), // 30
+
+      // Seed crystal
+      vkch::Constant<int32_t>(simulation_parameters.seed().radius()), // 31
+      vkch::Constant<int32_t>(simulation_parameters.seed().thickness()), // 32
+
+      // Field layout
+      vkch::Constant<int32_t>(
+        static_cast<int32_t>((packed_layout) ?
+          FieldLayout::PACKED : FieldLayout::PLANAR)), // 33
+    };
+  };
+  Medium const *specialised_medium =
+    &(simulation_parameters.mediumAt(current_timestep));
+  std::vector<vkch::ConstantBase> spec_constants_step =
+    specialise(*specialised_medium);
 
   std::shared_ptr<vkch::TensorParameterSet> params_step_01 =
     vkch_ctxt->tensorParameterSet({
       tensor_0,
       tensor_1
     });
-  Step_A.params_step_AB = params_step_01;
-
   std::shared_ptr<vkch::TensorParameterSet> params_step_10 =
     vkch_ctxt->tensorParameterSet({
       tensor_1,
       tensor_0
     });
-  Step_B.params_step_AB = params_step_10;
+  Step_A.params_step_AB = params_step_01;
+  Step_A.params_step_BA = params_step_10;
+  Step_B.params_step_AB =
+    (Step_B.tensor_A == tensor_0) ? params_step_01 : params_step_10;
+  Step_B.params_step_BA =
+    (Step_B.tensor_A == tensor_0) ? params_step_10 : params_step_01;
 
   std::shared_ptr<vkch::TensorParameterSet> params_render_0 =
     vkch_ctxt->tensorParameterSet({
       tensor_0
     });
-  Step_A.params_render_A = params_render_0;
   std::shared_ptr<vkch::TensorParameterSet> params_render_1 =
     vkch_ctxt->tensorParameterSet({
       tensor_1
     });
-  Step_B.params_render_A = params_render_1;
+  Step_A.params_render_A = params_render_0;
+  Step_B.params_render_A =
+    (Step_B.tensor_A == tensor_0) ? params_render_0 : params_render_1;
+  Step_A.params_init_A = Step_A.params_render_A;
+  Step_B.params_init_A = Step_B.params_render_A;
+
+  if (ensemble_enabled)
+  {
+    // Each step binds its own member records, initialising writes the
+    // output tensor of the step from B to A.
+    for (StepSimulation *step : { &Step_A, &Step_B })
+    {
+      step->params_step_AB =
+        vkch_ctxt->tensorParameterSet({
+          step->tensor_A,
+          step->tensor_B,
+          step->tensor_members
+        });
+      step->params_step_BA =
+        vkch_ctxt->tensorParameterSet({
+          step->tensor_B,
+          step->tensor_A,
+          step->tensor_members
+        });
+      step->params_init_A = step->params_step_BA;
+    } // step
+  }
 
+  if ((!fields_carried_over) && (!branches) && (!ensemble_enabled))
+  {
+    Step_A.program_init = Step_B.program_init =
+      vkch_ctxt->program(
+        spec_constants_step,
+        std::vector<vkch::ConstantBase>({}), // example
+        Step_A.params_init_A, // example
+        spirv_init
+      );
+  }
+
+  if (diagnostics_enabled)
+  {
+    std::shared_ptr<vkch::TensorParameterSet> params_reduce_01 =
+      vkch_ctxt->tensorParameterSet({
+        tensor_0,
+        tensor_1,
+        tensor_diagnostics_partials,
+        Step_A.tensor_diagnostics_ring
+      });
+    std::shared_ptr<vkch::TensorParameterSet> params_reduce_10 =
+      vkch_ctxt->tensorParameterSet({
+        tensor_1,
+        tensor_0,
+        tensor_diagnostics_partials,
+        Step_A.tensor_diagnostics_ring
+      });
+    Step_A.params_reduce_AB = params_reduce_01;
+    Step_A.params_reduce_BA = params_reduce_10;
+    Step_B.params_reduce_AB =
+      (Step_B.tensor_A == tensor_0) ? params_reduce_01 : params_reduce_10;
+    Step_B.params_reduce_BA =
+      (Step_B.tensor_A == tensor_0) ? params_reduce_10 : params_reduce_01;
+
+    Step_A.program_reduce = Step_B.program_reduce =
+      vkch_ctxt->program(
+        spec_constants_step,
+        Step_A.push_constants_reduce_partial, // example
+        params_reduce_01, // example
+        spirv_reduce
+      );
+  }
+
+  if (active_tiles_enabled)
+  {
+    std::shared_ptr<vkch::TensorParameterSet> params_active_01 =
+      vkch_ctxt->tensorParameterSet({
+        tensor_0,
+        tensor_1,
+        Step_A.tensor_active_dispatch,
+        Step_A.tensor_tile_flags
+      });
+    std::shared_ptr<vkch::TensorParameterSet> params_active_10 =
+      vkch_ctxt->tensorParameterSet({
+        tensor_1,
+        tensor_0,
+        Step_A.tensor_active_dispatch,
+        Step_A.tensor_tile_flags
+      });
+    Step_A.params_active_AB = params_active_01;
+    Step_A.params_active_BA = params_active_10;
+    Step_B.params_active_AB =
+      (Step_B.tensor_A == tensor_0) ? params_active_01 : params_active_10;
+    Step_B.params_active_BA =
+      (Step_B.tensor_A == tensor_0) ? params_active_10 : params_active_01;
+
+    Step_A.params_build_active = Step_B.params_build_active =
+      vkch_ctxt->tensorParameterSet({
+        Step_A.tensor_active_dispatch,
+        Step_A.tensor_tile_flags
+      });
+
+    Step_A.program_build_active = Step_B.program_build_active =
+      vkch_ctxt->program(
+        spec_constants_step,
+        Step_A.push_constants_flags_parity[0], // example
+        Step_A.params_build_active, // example
+        spirv_build_active
+      );
+  }
+
+  const std::vector<vkch::ConstantBase> push_constants_step_example =
+    (active_tiles_enabled) ?
+      Step_A.push_constants_flags_parity[0] :
+      ((medium_pushed) ?
+        StepSimulation::medium_push_constants(*specialised_medium) :
+        Step_A.push_constants_step);
+  const std::shared_ptr<vkch::TensorParameterSet> params_step_example =
+    (active_tiles_enabled) ?
+      Step_A.params_active_AB : Step_A.params_step_AB;
   std::shared_ptr<vkch::Program> program_step =
     Step_A.program_step = Step_B.program_step =
       vkch_ctxt->program(
         spec_constants_step,
-        std::vector<vkch::ConstantBase>({}), // example
-        params_step_01, // example
+        push_constants_step_example, // example
+        params_step_example, // example
         spirv_solver_substep
       );
+  if (ensemble_enabled && (!fields_carried_over) && (!branches))
+  {
+    Step_A.program_init = Step_B.program_init = program_step;
+  }
 
 #if !defined(NO_GUI)
   if (!no_gui)
@@ -209,28 +736,312 @@ void simulation_thread(
   time_series_measurements.squared_velocity_timeseries = nullptr;
 */
 
+  // Reductions land in consecutive ring slots in submission order. Once a
+  // step has completed its slots are final in staging, a later submission
+  // only rewrites them with identical contents or fills other slots.
+  uintmax_t diagnostics_read = 0;
+  auto drain_diagnostics = [&](StepSimulation &step)
+  {
+    if (step.diagnostics_steps.empty()) return;
+
+    std::vector<DiagnosticsSample> samples;
+    for (size_t d = 0; d < step.diagnostics_steps.size(); d++)
+    {
+      const uintmax_t slot = diagnostics_read % diagnostics_ring_capacity;
+      samples.emplace_back(
+        step.diagnostics_steps[d],
+        &(step.tensor_diagnostics_ring->data()[
+          DIAGNOSTICS_HEADER_WORDS + slot * DIAGNOSTICS_RECORD_WORDS]));
+      diagnostics_read++;
+    } // d
+    step.diagnostics_steps.clear();
+
+    simulation.record_diagnostics(samples);
+
+    if (adaptive_growth)
+    {
+      const DiagnosticsSample &latest = samples.back();
+      const int margin = final_parameters.growthMargin();
+      if (((latest.depleted_radius_t() + margin) >=
+          simulation_parameters.radiusT()) &&
+        AdaptiveGrid::can_grow_T(simulation_parameters, final_parameters))
+      {
+        grow_T = true;
+      }
+      if (((latest.depleted_radius_z() + margin) >=
+          simulation_parameters.radiusZ()) &&
+        AdaptiveGrid::can_grow_Z(simulation_parameters, final_parameters))
+      {
+        grow_Z = true;
+      }
+    }
+  };
+
+  // Measurements always see the full grid of the final voxel counts,
+  // reconstructed from the wedge with a symmetry or unpacked, and embedded in
+  // the final grid with adaptive growth.
+  std::vector<float> expanded_fields;
+  if (symmetry_enabled || packed_layout)
+  {
+    expanded_fields.resize(per_field_size * SOLVER_FIELD_COUNT);
+  }
+  std::vector<float> embedded_fields;
+  if (adaptive_growth)
+  {
+    embedded_fields.resize(
+      final_parameters.readback().element_count(final_counts));
+  }
+  // Snapshots of ensemble members follow one another in staging.
+  uintmax_t member_snapshot_size = 0;
+  if (ensemble_enabled)
+  {
+    const int counts[3] = {
+      simulation_parameters.voxelXCount(),
+      simulation_parameters.voxelYCount(),
+      simulation_parameters.voxelZCount()
+    };
+    member_snapshot_size =
+      simulation_parameters.readback().element_count(counts);
+  }
+
+  const uintmax_t measurement_interval =
+    static_cast<uintmax_t>(simulation_parameters.measurementInterval());
+  const uintmax_t checkpoint_interval = (checkpoint_writer != nullptr) ?
+    static_cast<uintmax_t>(final_parameters.checkpointInterval()) : 0;
+
+  // Runs on the thread of the measurement ring while the simulation goes
+  // on, from the slot downloaded for the timestep, with the members active
+  // when it was handed over. A simulation asked to stop measures no more.
+  // A slot read back on the transfer queue is complete once the transfer
+  // timeline reaches its value, zero for the compute queue.
+  std::vector<std::vector<bool> > slot_member_active(measurement_depth);
+  std::vector<uint64_t> slot_readback_value(measurement_depth, 0);
+  auto measure = [&](unsigned int slot, uintmax_t timestep)
+  {
+    if (*stop_thread) return;
+
+    if (transfer_timeline != nullptr)
+    {
+      transfer_timeline->wait(slot_readback_value[slot]);
+    }
+
+    float *all_fields = measurement_slots[slot]->data();
+    if (ensemble_enabled)
+    {
+      for (unsigned int m = 0; m < member_count; m++)
+      {
+        if (!slot_member_active[slot][m]) continue;
+
+        simulation.perform_measurements(
+          all_fields + m * member_snapshot_size, timestep,
+          static_cast<int>(m), branches);
+      } // m
+      return;
+    }
+    if (symmetry_enabled)
+    {
+      wedge.expand(all_fields, expanded_fields.data(),
+        simulation_parameters.voxelXCount(),
+        simulation_parameters.voxelYCount(),
+        simulation_parameters.voxelZCount(),
+        simulation_parameters.readback(),
+        initial_dirichlet_params);
+      all_fields = expanded_fields.data();
+    } else if (packed_layout)
+    {
+      packed.unpack(all_fields, expanded_fields.data(),
+        simulation_parameters.readback());
+      all_fields = expanded_fields.data();
+    }
+    if (adaptive_growth)
+    {
+      AdaptiveGrid::embed(all_fields, simulation_parameters,
+        embedded_fields.data(), final_parameters,
+        final_parameters.readback(),
+        initial_dirichlet_params);
+      all_fields = embedded_fields.data();
+    }
+    simulation.perform_measurements(all_fields, timestep);
+  };
+  // Declared after everything the measurements use, so that it measures
+  // the slots still submitted before any of it is released.
+  MeasurementRing measurement_ring(measurement_depth,
+    simulation_parameters.measurementBackpressure(),
+    [](unsigned int slot, uintmax_t timestep, void *user_pointer)
+    {
+      (*reinterpret_cast<decltype(measure) *>(user_pointer))(slot, timestep);
+    },
+    &measure);
+
+  // Checkpoints hold the whole grid, reconstructed from the wedge with a
+  // symmetry, and resume with the step after the downloaded one.
+  auto write_checkpoint = [&](StepSimulation &step)
+  {
+    Checkpoint *checkpoint = checkpoint_writer->acquire();
+    if (checkpoint == nullptr)
+    {
+      fprintf(stderr, "Checkpoint at step %ju skipped, the previous one is "
+        "still being written.\n", step.last_timestep());
+      return;
+    }
+
+    checkpoint->voxel_counts[0] = simulation_parameters.voxelXCount();
+    checkpoint->voxel_counts[1] = simulation_parameters.voxelYCount();
+    checkpoint->voxel_counts[2] = simulation_parameters.voxelZCount();
+    checkpoint->step = step.last_timestep() + 1;
+    float const *all_fields = step.result_tensor()->data();
+    if (symmetry_enabled)
+    {
+      checkpoint->fields.resize(per_field_size * SOLVER_FIELD_COUNT);
+      wedge.expand(all_fields, checkpoint->fields.data(),
+        simulation_parameters.voxelXCount(),
+        simulation_parameters.voxelYCount(),
+        simulation_parameters.voxelZCount(),
+        ReadbackRegion(),
+        initial_dirichlet_params);
+    } else if (packed_layout)
+    {
+      checkpoint->fields.resize(per_field_size * SOLVER_FIELD_COUNT);
+      packed.unpack(all_fields, checkpoint->fields.data(), ReadbackRegion());
+    } else
+    {
+      checkpoint->fields.assign(all_fields,
+        all_fields + per_field_size * SOLVER_FIELD_COUNT * member_count);
+    }
+    checkpoint_writer->submit();
+  };
+
+  // Results are downloaded whole for checkpoints, and into a slot of the
+  // measurement ring for measurements. A slot is acquired for the
+  // submission about to be made, none if the measurement is dropped.
+  auto download_due = [&](StepSimulation const &step)
+  {
+    return step.checkpoint_due(checkpoint_interval);
+  };
+  auto measurement_slot = [&](StepSimulation const &step)
+  {
+    return (step.measurement_due(measurement_interval)) ?
+      measurement_ring.acquire() : -1;
+  };
+  auto collect = [&](StepSimulation &step)
+  {
+    if (step.downloaded && (checkpoint_writer != nullptr))
+    {
+      write_checkpoint(step);
+    }
+    if (step.measurement_slot >= 0)
+    {
+      slot_member_active[step.measurement_slot] = member_active;
+      slot_readback_value[step.measurement_slot] =
+        (transfer_timeline != nullptr) ? step.readback_value : 0;
+      measurement_ring.submit(step.measurement_slot, step.last_timestep());
+      step.measurement_slot = -1;
+    }
+  };
+
+  // Clear the flags of members asked to stop in the records of a step about
+  // to be scheduled, its previous submission has completed. The simulation
+  // stops with its last member.
+  auto update_members = [&](StepSimulation &step)
+  {
+    if (!ensemble_enabled) return;
+
+    std::vector<bool> members_stopping = simulation.members_stopping();
+    for (unsigned int m = 0; m < member_count; m++)
+    {
+      if (member_active[m] && members_stopping[m])
+      {
+        member_active[m] = false;
+        members_remaining--;
+      }
+      step.tensor_members->data()[
+        m * ENSEMBLE_MEMBER_WORDS + ENSEMBLE_MEMBER_ACTIVE] =
+          (member_active[m]) ? 1.f : 0.f;
+    } // m
+    if (members_remaining == 0)
+    {
+      *stop_thread = 1;
+    }
+  };
+
+  // A solver specialised to a scheduled medium is rebuilt for the first
+  // submission starting at or after the change, a change within a submission
+  // waits for the next one. The submission in flight keeps the program it
+  // was recorded with, and a medium scheduled before reuses its program.
+  auto update_medium = [&](StepSimulation &step)
+  {
+    if (medium_pushed || ensemble_enabled) return;
+
+    Medium const *medium =
+      &(simulation_parameters.mediumAt(current_timestep));
+    if (medium != specialised_medium)
+    {
+      specialised_medium = medium;
+      program_step =
+        vkch_ctxt->program(
+          specialise(*specialised_medium),
+          push_constants_step_example, // example
+          params_step_example, // example
+          spirv_solver_substep
+        );
+    }
+    step.program_step = program_step;
+  };
+
   Step_A.init_schemas(simulation_parameters, vkch_ctxt);
   Step_B.init_schemas(simulation_parameters, vkch_ctxt);
 
+  const uintmax_t first_scheduled_timestep = current_timestep;
+  update_members(Step_A);
+  update_medium(Step_A);
   Step_A.schedule(
     volume_buffers,
-    simulation_parameters, current_timestep++);
-  Step_A.submit(true, true, nullptr);
+    simulation_parameters, current_timestep);
+  current_timestep += steps_per_submission;
+  // With an even substep count both steps leave their result in the same
+  // tensor, so a checkpoint download must not be queued while the host is
+  // still reading the staging memory of the previous one.
+  const bool shared_result =
+    (Step_A.result_tensor() == Step_B.result_tensor());
+
+  Step_A.submit(true,
+    download_due(Step_A), nullptr,
+    measurement_slot(Step_A));
   // Must wait for this to complete to prevent overwriting of the tx_data
   // tensors later?
   Step_A.getLastSchema()->waitForCompletion();
+  drain_diagnostics(Step_A);
+  if (branches)
+  {
+    // Every branch holds its copy, the simulation that forked is released.
+    Step_A.schema_upload->clear();
+    Step_A.tensor_fork_source = nullptr;
+    forked_fields.fields = nullptr;
+    forked_fields.ctxt->clear();
+    forked_fields.ctxt = nullptr;
+  }
+  update_members(Step_B);
+  update_medium(Step_B);
   Step_B.schedule(
     volume_buffers,
-    simulation_parameters, current_timestep++);
-  Step_B.submit(false, true, Step_A.getLastSchema());
+    simulation_parameters, current_timestep);
+  current_timestep += steps_per_submission;
+  Step_B.submit(false,
+    (!shared_result) && download_due(Step_B),
+    Step_A.getLastSchema(),
+    measurement_slot(Step_B));
+  // Holds the latest state once everything submitted has completed.
+  StepSimulation *last_submitted = &Step_B;
 
   int steps_until_end_of_transition = 0;
-  while (!(*stop_thread))
+  while (!(*stop_thread) && !(grow_T || grow_Z) && !fork_reached())
   {
     Step_A.getLastSchema()->waitForCompletion();
-    Simulation::get().perform_measurements(
-      tensor_1->data(),
-      (current_timestep - 1));
+    drain_diagnostics(Step_A);
+    collect(Step_A);
+    if (shared_result && download_due(Step_B))
+      Step_B.submit_download(Step_B.getLastSchema());
+    if (grow_T || grow_Z) break;
 
     if (!no_gui)
     {
@@ -250,15 +1061,24 @@ void simulation_thread(
 
     } // (!no_gui)
 
+    update_members(Step_A);
+    update_medium(Step_A);
     Step_A.schedule(
       volume_buffers,
-      simulation_parameters, current_timestep++);
-    Step_A.submit(false, true, Step_B.getLastSchema());
+      simulation_parameters, current_timestep);
+    current_timestep += steps_per_submission;
+    Step_A.submit(false,
+      (!shared_result) && download_due(Step_A),
+      Step_B.getLastSchema(),
+      measurement_slot(Step_A));
+    last_submitted = &Step_A;
 
     Step_B.getLastSchema()->waitForCompletion();
-    Simulation::get().perform_measurements(
-      tensor_0->data(),
-      (current_timestep - 1));
+    drain_diagnostics(Step_B);
+    collect(Step_B);
+    if (shared_result && download_due(Step_A))
+      Step_A.submit_download(Step_A.getLastSchema());
+    if (fork_reached()) break;
 
 #if !defined(NO_GUI)
     if (!no_gui)
@@ -280,15 +1100,293 @@ void simulation_thread(
     } // (!no_gui)
 #endif // !defined(NO_GUI)
 
+    update_members(Step_B);
+    update_medium(Step_B);
     Step_B.schedule(
       volume_buffers,
-      simulation_parameters, current_timestep++);
-    Step_B.submit(false, true, Step_A.getLastSchema());
+      simulation_parameters, current_timestep);
+    current_timestep += steps_per_submission;
+    Step_B.submit(false,
+      (!shared_result) && download_due(Step_B),
+      Step_A.getLastSchema(),
+      measurement_slot(Step_B));
+    last_submitted = &Step_B;
 
   }
 
   Step_A.getLastSchema()->waitForCompletion();
+  drain_diagnostics(Step_A);
   Step_B.getLastSchema()->waitForCompletion();
+  drain_diagnostics(Step_B);
+  simulation.record_host_time(Step_A.host_seconds + Step_B.host_seconds,
+    current_timestep - first_scheduled_timestep);
+  // Nothing may still be reading back into the slots once they go, measured
+  // or not.
+  if (transfer_timeline != nullptr)
+  {
+    transfer_timeline->wait(transfer_timeline->last());
+  }
+  if (measurement_ring.dropped() > 0)
+  {
+    fprintf(stderr, "%ju measurements dropped, the measurement callback "
+      "fell behind.\n", measurement_ring.dropped());
+  }
+
+  if ((*stop_thread) || !(grow_T || grow_Z || fork_reached())) return false;
+
+  // Carry the latest state over to the grown grid, or on the device to the
+  // branches of the fork, after measuring it if it was due. Adaptive growth
+  // always downloads the full grid.
+  collect(*last_submitted);
+  if (fork_reached())
+  {
+    forked_fields.ctxt = vkch_ctxt;
+    forked_fields.fields = last_submitted->result_tensor();
+    return true;
+  }
+  if (!last_submitted->downloaded)
+  {
+    last_submitted->submit_download(last_submitted->getLastSchema());
+    last_submitted->getLastSchema()->waitForCompletion();
+  }
+
+  grid_fields.resize(per_field_size * SOLVER_FIELD_COUNT);
+  if (symmetry_enabled)
+  {
+    wedge.expand(last_submitted->result_tensor()->data(), grid_fields.data(),
+      simulation_parameters.voxelXCount(),
+      simulation_parameters.voxelYCount(),
+      simulation_parameters.voxelZCount(),
+      ReadbackRegion(),
+      initial_dirichlet_params);
+  } else if (packed_layout)
+  {
+    packed.unpack(last_submitted->result_tensor()->data(), grid_fields.data(),
+      ReadbackRegion());
+  } else
+  {
+    std::copy(last_submitted->result_tensor()->data(),
+      last_submitted->result_tensor()->data() +
+        per_field_size * SOLVER_FIELD_COUNT,
+      grid_fields.begin());
+  }
+
+  grown_parameters = AdaptiveGrid::grown(
+    simulation_parameters, final_parameters, grow_T, grow_Z);
+  return true;
+}
+
+void simulation_thread(
+  Simulation &simulation,
+  volatile int *stop_thread,
+  bool no_gui,
+  const std::shared_ptr<VolumeBuffers> &volume_buffers,
+  std::shared_ptr<vkch::Context> &vkch_ctxt,
+  SimulationParameters const &simulation_parameters)
+{
+  // The GUI renders into volume buffers of the full voxel counts.
+  SimulationParameters final_parameters = simulation_parameters;
+  if (final_parameters.adaptiveGrowth() && !no_gui)
+  {
+    fprintf(stderr, "Adaptive growth is only supported without the GUI, "
+      "using the full grid.\n");
+    final_parameters.setAdaptiveGrowth(false);
+  }
+
+  // A fork copies the whole grid of the simulation into its branches.
+  if (final_parameters.forks() && (final_parameters.ensembleSize() > 0))
+  {
+    fprintf(stderr, "Ensembles cannot fork, running without the fork.\n");
+    final_parameters.setForkStep(0);
+  }
+  if (final_parameters.forks() &&
+    ((final_parameters.symmetry() != SymmetryMode::NONE) ||
+      (final_parameters.adaptiveGrowth())))
+  {
+    fprintf(stderr, "Forked simulations run without symmetry or adaptive "
+      "growth.\n");
+    final_parameters.setSymmetry(SymmetryMode::NONE);
+    final_parameters.setAdaptiveGrowth(false);
+  }
+
+  // The GUI shows the first member of an ensemble.
+  if ((final_parameters.ensembleSize() > 0) &&
+    ((final_parameters.symmetry() != SymmetryMode::NONE) ||
+      (final_parameters.solverKernel() != SolverKernel::DIRECT) ||
+      (final_parameters.adaptiveGrowth()) ||
+      (final_parameters.diagnosticsInterval() > 0)))
+  {
+    fprintf(stderr, "Ensembles use the direct solver kernel without "
+      "symmetry, adaptive growth or diagnostics.\n");
+    final_parameters.setSymmetry(SymmetryMode::NONE);
+    final_parameters.setSolverKernel(SolverKernel::DIRECT);
+    final_parameters.setAdaptiveGrowth(false);
+    final_parameters.setDiagnosticsInterval(0);
+  }
+
+  // Pushed media are read by the direct solver kernel over the whole domain.
+  if ((final_parameters.mediumMode() == MediumMode::PUSH_CONSTANTS) &&
+    (final_parameters.ensembleSize() == 0) &&
+    ((final_parameters.symmetry() != SymmetryMode::NONE) ||
+      (final_parameters.solverKernel() != SolverKernel::DIRECT)))
+  {
+    fprintf(stderr, "Pushed media use the direct solver kernel without "
+      "symmetry.\n");
+    final_parameters.setSymmetry(SymmetryMode::NONE);
+    final_parameters.setSolverKernel(SolverKernel::DIRECT);
+  }
+
+  // Only the direct solver kernel reads the packed layout, over the whole
+  // domain of a single simulation with media in a buffer that does not fork.
+  if ((final_parameters.fieldLayout() == FieldLayout::PACKED) &&
+    !PackedFields::enabled(final_parameters))
+  {
+    fprintf(stderr, "Packed fields need the direct solver kernel without "
+      "symmetry, ensembles, forks or pushed media, using the planar "
+      "layout.\n");
+    final_parameters.setFieldLayout(FieldLayout::PLANAR);
+  }
+
+  const float quiescent[SOLVER_FIELD_COUNT] = {
+    0.f,
+    float(simulation_parameters.medium().rho()),
+    0.f
+  };
+
+  // The branches of a fork continue as an ensemble of the fork media. They
+  // run in this context, the simulation before the fork in a context of its
+  // own on the same device, so both can be allocated while the fields are
+  // copied from one to the other.
+  SimulationParameters branch_parameters = final_parameters;
+  SimulationParameters checkpointed_branch_parameters = simulation_parameters;
+  for (SimulationParameters *parameters :
+    { &branch_parameters, &checkpointed_branch_parameters })
+  {
+    parameters->setEnsembleMedia(final_parameters.forkMedia());
+    parameters->setForkStep(0);
+    parameters->setForkMedia(std::vector<Medium>());
+    if (!PackedFields::enabled(*parameters))
+    {
+      parameters->setFieldLayout(FieldLayout::PLANAR);
+    }
+  }
+  branch_parameters.setSolverKernel(SolverKernel::DIRECT);
+  branch_parameters.setDiagnosticsInterval(0);
+  std::shared_ptr<vkch::Context> grid_ctxt =
+    (final_parameters.forks()) ? vkch_ctxt->share() : vkch_ctxt;
+  ForkedFields forked_fields;
+
+  SimulationParameters grid_parameters =
+    (final_parameters.adaptiveGrowth()) ?
+      AdaptiveGrid::initial(final_parameters) : final_parameters;
+  uintmax_t current_timestep = 0;
+  std::vector<float> grid_fields;
+  SimulationParameters grown_parameters;
+
+  // A resumed simulation carries the fields of its checkpoint over like
+  // those of a grown grid, on the grid the checkpoint had reached, instead
+  // of initialising them on the device.
+  std::shared_ptr<Checkpoint> resume_checkpoint =
+    simulation.take_resume_checkpoint();
+  if (resume_checkpoint != nullptr)
+  {
+    current_timestep = resume_checkpoint->step;
+    grid_fields = std::move(resume_checkpoint->fields);
+    grid_parameters.setVoxelXCount(resume_checkpoint->voxel_counts[0]);
+    grid_parameters.setVoxelYCount(resume_checkpoint->voxel_counts[1]);
+    grid_parameters.setVoxelZCount(resume_checkpoint->voxel_counts[2]);
+
+    // Without adaptive growth, e.g. with the GUI, the final grid at once.
+    if ((!final_parameters.adaptiveGrowth()) &&
+      ((grid_parameters.voxelXCount() != final_parameters.voxelXCount()) ||
+        (grid_parameters.voxelYCount() != final_parameters.voxelYCount()) ||
+        (grid_parameters.voxelZCount() != final_parameters.voxelZCount())))
+    {
+      std::vector<float> final_fields(
+        uintmax_t(final_parameters.voxelXCount()) *
+        uintmax_t(final_parameters.voxelYCount()) *
+        uintmax_t(final_parameters.voxelZCount()) * SOLVER_FIELD_COUNT);
+      AdaptiveGrid::embed(grid_fields.data(), grid_parameters,
+        final_fields.data(), final_parameters,
+        ReadbackRegion(), quiescent);
+      grid_fields = std::move(final_fields);
+      grid_parameters = final_parameters;
+    }
+    resume_checkpoint = nullptr;
+
+#if !defined(BUILD_PYTHON_BINDINGS)
+    fprintf(stderr, "resuming on %dx%dx%d grid at step %ju...\n",
+      grid_parameters.voxelXCount(),
+      grid_parameters.voxelYCount(),
+      grid_parameters.voxelZCount(),
+      current_timestep);
+#endif // !defined(BUILD_PYTHON_BINDINGS)
+  }
+
+  // Checkpoints record the parameters the simulation was started with, a
+  // resumed simulation makes the same adjustments to them. The field layout
+  // is the one that ran.
+  std::unique_ptr<CheckpointWriter> checkpoint_writer = nullptr;
+  if ((!simulation_parameters.checkpointFile().empty()) &&
+    (simulation_parameters.checkpointInterval() > 0))
+  {
+    SimulationParameters checkpointed_parameters = simulation_parameters;
+    checkpointed_parameters.setFieldLayout(final_parameters.fieldLayout());
+    checkpoint_writer = std::make_unique<CheckpointWriter>(
+      simulation_parameters.checkpointFile(), checkpointed_parameters);
+  }
+
+  while (simulate_grid(simulation,
+    stop_thread, no_gui, volume_buffers, grid_ctxt,
+    final_parameters, grid_parameters,
+    current_timestep, grid_fields, grown_parameters,
+    forked_fields, checkpoint_writer.get()))
+  {
+    if (forked_fields.fields != nullptr)
+    {
+      final_parameters = branch_parameters;
+      grid_parameters = branch_parameters;
+      grid_ctxt = vkch_ctxt;
+
+      // Checkpoints of the branches resume as an ensemble.
+      if (checkpoint_writer != nullptr)
+      {
+        checkpoint_writer = nullptr;
+        checkpoint_writer = std::make_unique<CheckpointWriter>(
+          simulation_parameters.checkpointFile(),
+          checkpointed_branch_parameters);
+      }
+
+#if !defined(BUILD_PYTHON_BINDINGS)
+      fprintf(stderr, "forked into %d branches at step %ju...\n",
+        branch_parameters.ensembleSize(), current_timestep);
+#endif // !defined(BUILD_PYTHON_BINDINGS)
+      continue;
+    }
+
+    // Everything of the smaller grid is released before the memory pools
+    // are sized for the grown one. All its schemas have completed, and the
+    // device may be shared with other simulations, so it is not idled.
+    grid_ctxt->clear();
+
+    std::vector<float> grown_fields(
+      uintmax_t(grown_parameters.voxelXCount()) *
+      uintmax_t(grown_parameters.voxelYCount()) *
+      uintmax_t(grown_parameters.voxelZCount()) * SOLVER_FIELD_COUNT);
+    AdaptiveGrid::embed(grid_fields.data(), grid_parameters,
+      grown_fields.data(), grown_parameters,
+      ReadbackRegion(), quiescent);
+    grid_fields = std::move(grown_fields);
+    grid_parameters = grown_parameters;
+
+#if !defined(BUILD_PYTHON_BINDINGS)
+    fprintf(stderr, "grew grid to %dx%dx%d at step %ju...\n",
+      grid_parameters.voxelXCount(),
+      grid_parameters.voxelYCount(),
+      grid_parameters.voxelZCount(),
+      current_timestep);
+#endif // !defined(BUILD_PYTHON_BINDINGS)
+  }
 
 #if !defined(BUILD_PYTHON_BINDINGS)
   fprintf(stderr, "completed shutdown (compute)...\n");
@@ -1,13 +1,46 @@
 #pragma once
 
 #include "SimulationParameters.h"
+#include "Checkpoint.hpp"
 
 #include "VulkanComputeHelper.h"
 #include "renderer/VolumeBuffers.h"
 
 namespace vkch = vkComputeHelper;
 
+class Simulation;
+
+// Result fields of a simulation that forked, still on the device in the
+// memory pools of the context it ran in.
+struct ForkedFields
+{
+  std::shared_ptr<vkch::Context> ctxt;
+  std::shared_ptr<vkch::SharedTensor<float> > fields;
+};
+
+// Simulates on the grid of the given parameters, until stopped or until
+// adaptive growth or a fork is due. Returns true with the fields of the grid
+// and the parameters of the grown grid when it must continue on a grown
+// grid, or with the forked fields when its branches must continue from them.
+// With forked fields to begin with, every member starts from a device copy
+// of them, which is released once copied. Checkpoints go to the writer, if
+// any.
+bool simulate_grid(
+  Simulation &simulation,
+  volatile int *stop_thread,
+  bool no_gui,
+  const std::shared_ptr<VolumeBuffers> &volume_buffers,
+  std::shared_ptr<vkch::Context> &vkch_ctxt,
+  SimulationParameters const &final_parameters,
+  SimulationParameters const &simulation_parameters,
+  uintmax_t &current_timestep,
+  std::vector<float> &grid_fields,
+  SimulationParameters &grown_parameters,
+  ForkedFields &forked_fields,
+  CheckpointWriter *checkpoint_writer);
+
 void simulation_thread(
+  Simulation &simulation,
   volatile int *stop_thread,
   bool no_gui,
   const std::shared_ptr<VolumeBuffers> &volume_buffers,
@@ -11,3 +11,52 @@
 #define FIELD_BOUNDARY_MASS  2
 
 #define BOUNDARY_THICKNESS 3
+
+// Workgroup sizes of the solver kernels, must match the shaders.
+#define SOLVER_DIRECT_X 64
+#define SOLVER_TILE_X 32
+#define SOLVER_TILE_Y 4
+#define SOLVER_TILE_Z 2
+#define SOLVER_TEMPORAL_FOOTPRINT_X 12
+#define SOLVER_TEMPORAL_FOOTPRINT_Y 12
+#define SOLVER_TEMPORAL_FOOTPRINT_Z 8
+#define SOLVER_TEMPORAL_MAX_STEPS 3
+#define SOLVER_ACTIVE_TILE_X 8
+#define SOLVER_ACTIVE_TILE_Y 8
+#define SOLVER_ACTIVE_TILE_Z 4
+#define SOLVER_ACTIVE_BUILD_X 64
+// Dispatch counts and reserved word ahead of the active tile list.
+#define SOLVER_ACTIVE_HEADER_WORDS 4
+// Two copies of occupancy and diffusive mass, one of boundary mass.
+#define SOLVER_TEMPORAL_SHARED_BYTES \
+  (5 * SOLVER_TEMPORAL_FOOTPRINT_X * SOLVER_TEMPORAL_FOOTPRINT_Y * \
+    SOLVER_TEMPORAL_FOOTPRINT_Z * 4)
+
+// GPU diagnostics reductions, each record is 8 32-bit words.
+#define DIAGNOSTICS_RECORD_WORDS 8
+#define DIAGNOSTICS_HEADER_WORDS 8
+#define DIAGNOSTICS_REDUCTION_WORKGROUPS 256
+#define DIAGNOSTICS_RING_CAPACITY 1024
+
+// Adaptive grid growth, checked on diagnostics reduced at least this often.
+#define GROWTH_CHECK_INTERVAL 32
+// Each growth multiplies the voxel counts by GROWTH_NUMERATOR /
+// GROWTH_DENOMINATOR, rounded up to a multiple of GROWTH_GRANULARITY.
+#define GROWTH_NUMERATOR 3
+#define GROWTH_DENOMINATOR 2
+#define GROWTH_GRANULARITY 8
+
+// Ensemble members, each a record of 32 floats: the active flag, rho, phi,
+// then kappa, mu and beta by neighbour configuration. Must match
+// solver_substep_ensemble.comp.
+#define ENSEMBLE_MEMBER_WORDS 32
+#define ENSEMBLE_MEMBER_ACTIVE 0
+#define ENSEMBLE_MEMBER_RHO 1
+#define ENSEMBLE_MEMBER_PHI 2
+#define ENSEMBLE_MEMBER_KAPPA 3
+#define ENSEMBLE_MEMBER_MU 11
+#define ENSEMBLE_MEMBER_BETA 19
+
+// Batch point sampling on the host spreads at least this many points over
+// each thread.
+#define SAMPLE_POINTS_PER_THREAD 65536
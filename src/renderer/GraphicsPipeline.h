@@ -133,6 +133,7 @@ inline vk::raii::RenderPass makeRenderPass(
 
 inline vk::raii::Pipeline makeGraphicsPipeline(
   vk::raii::Device const &device,
+  vk::raii::PipelineCache const &pipeline_cache,
   vk::raii::ShaderModule const &vertex_shader_module,
   vk::SpecializationInfo const *vertex_shader_specialization_info,
   vk::raii::ShaderModule const &fragment_shader_module,
@@ -262,7 +263,7 @@ inline vk::raii::Pipeline makeGraphicsPipeline(
     render_pass
   );
 
-  return device.createGraphicsPipeline(nullptr, graphics_pipeline_info);
+  return device.createGraphicsPipeline(pipeline_cache, graphics_pipeline_info);
 
 //  return vk::raii::Pipeline(device, nullptr, graphics_pipeline_info);
 }
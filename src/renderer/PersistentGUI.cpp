@@ -239,6 +239,7 @@ void initialise_gui(
     vk::raii::Pipeline(
       makeGraphicsPipeline(
         vkch_ctxt->device(),
+        vkch_ctxt->pipeline_cache(),
         *(persistent_gui.slines_vertex), nullptr,
         *(persistent_gui.slines_fragment), nullptr,
         sizeof(float) * 8,
@@ -259,6 +260,7 @@ void initialise_gui(
     vk::raii::Pipeline(
       makeGraphicsPipeline(
         vkch_ctxt->device(),
+        vkch_ctxt->pipeline_cache(),
         *(persistent_gui.svolume_vertex), nullptr,
         *(persistent_gui.svolume_fragment), nullptr,
         sizeof(float) * 8,
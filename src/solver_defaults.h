@@ -17,3 +17,22 @@
 #define DEFAULT_BETA_21 1.0
 #define DEFAULT_BETA_30 1.0
 #define DEFAULT_BETA_31 1.0
+
+#define DEFAULT_STEPS_PER_SUBMIT 1
+#define DEFAULT_MEASUREMENT_INTERVAL 1
+#define DEFAULT_DIAGNOSTICS_INTERVAL 0
+#define DEFAULT_SOLVER_KERNEL SolverKernel::DIRECT
+#define DEFAULT_TEMPORAL_BLOCKING_STEPS 2
+#define DEFAULT_SYMMETRY SymmetryMode::NONE
+#define DEFAULT_ADAPTIVE_GROWTH false
+#define DEFAULT_GROWTH_MARGIN 8
+#define DEFAULT_GROWTH_DEPLETION_TOLERANCE 1e-3
+#define DEFAULT_CHECKPOINT_INTERVAL 0
+#define DEFAULT_FORK_STEP 0
+#define DEFAULT_MEDIUM_MODE MediumMode::SPECIALISED
+#define DEFAULT_MEASUREMENT_DEPTH 3
+#define DEFAULT_MEASUREMENT_BACKPRESSURE MeasurementBackpressure::BLOCK
+#define DEFAULT_FIELD_LAYOUT FieldLayout::PLANAR
+#define DEFAULT_RECORD_EVERY_SUBMISSION false
+
+#define DEFAULT_SWEEP_MAX_STEPS 10000